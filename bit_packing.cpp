@@ -0,0 +1,146 @@
+#include <algorithm>
+#include "bit_packing.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BIT_PACKING_SSE2
+#endif
+
+namespace {
+
+const size_t LANE_COUNT = 4;
+const size_t VALUES_PER_LANE = PACKED_BLOCK_SIZE / LANE_COUNT;
+
+uint32_t LowBitsMask(uint8_t bits) {
+    return bits >= 32 ? ~uint32_t(0) : (uint32_t(1) << bits) - 1;
+}
+
+#ifndef BIT_PACKING_SSE2
+void UnpackBlockScalar(const uint32_t* in, uint8_t bits, uint32_t* out) {
+    const uint32_t mask = LowBitsMask(bits);
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        size_t word = 0;
+        uint8_t shift = 0;
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+            uint32_t value = in[LANE_COUNT * word + lane] >> shift;
+            shift += bits;
+            if (shift >= 32) {
+                shift -= 32;
+                ++word;
+                if (shift > 0) {
+                    value |= in[LANE_COUNT * word + lane] << (bits - shift);
+                }
+            }
+            out[LANE_COUNT * i + lane] = value & mask;
+        }
+    }
+}
+
+void PrefixSumBlockScalar(uint32_t* values, uint32_t base) {
+    for (size_t i = 0; i < PACKED_BLOCK_SIZE; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+}
+#else
+void UnpackBlockSse2(const uint32_t* in, uint8_t bits, uint32_t* out) {
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(LowBitsMask(bits)));
+    const __m128i* source = reinterpret_cast<const __m128i*>(in);
+    __m128i* destination = reinterpret_cast<__m128i*>(out);
+    size_t word = 0;
+    uint8_t shift = 0;
+    __m128i current = _mm_loadu_si128(source);
+    for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(shift));
+        shift += bits;
+        if (shift >= 32) {
+            shift -= 32;
+            ++word;
+            // the last value of a lane ends exactly on a word boundary, there is nothing to load after it
+            if (word < bits) {
+                current = _mm_loadu_si128(source + word);
+                if (shift > 0) {
+                    value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(bits - shift)));
+                }
+            }
+        }
+        _mm_storeu_si128(destination + i, _mm_and_si128(value, mask));
+    }
+}
+
+void PrefixSumBlockSse2(uint32_t* values, uint32_t base) {
+    __m128i* data = reinterpret_cast<__m128i*>(values);
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+        __m128i value = _mm_loadu_si128(data + i);
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+        value = _mm_add_epi32(value, carry);
+        _mm_storeu_si128(data + i, value);
+        carry = _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+#endif
+
+} // namespace
+
+uint8_t RequiredBits(const uint32_t* values, size_t count) {
+    uint32_t accumulated = 0;
+    for (size_t i = 0; i < count; ++i) {
+        accumulated |= values[i];
+    }
+    uint8_t bits = 0;
+    while (accumulated != 0) {
+        ++bits;
+        accumulated >>= 1;
+    }
+    return bits;
+}
+
+size_t PackedBlockWords(uint8_t bits) {
+    return LANE_COUNT * bits;
+}
+
+void PackBlock(const uint32_t* values, uint8_t bits, uint32_t* out) {
+    std::fill(out, out + PackedBlockWords(bits), 0);
+    if (bits == 0) {
+        return;
+    }
+    const uint32_t mask = LowBitsMask(bits);
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        size_t word = 0;
+        uint8_t shift = 0;
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+            const uint32_t value = values[LANE_COUNT * i + lane] & mask;
+            out[LANE_COUNT * word + lane] |= value << shift;
+            shift += bits;
+            if (shift >= 32) {
+                shift -= 32;
+                ++word;
+                if (shift > 0) {
+                    out[LANE_COUNT * word + lane] |= value >> (bits - shift);
+                }
+            }
+        }
+    }
+}
+
+void UnpackBlock(const uint32_t* in, uint8_t bits, uint32_t* out) {
+    if (bits == 0) {
+        std::fill(out, out + PACKED_BLOCK_SIZE, 0);
+        return;
+    }
+#ifdef BIT_PACKING_SSE2
+    UnpackBlockSse2(in, bits, out);
+#else
+    UnpackBlockScalar(in, bits, out);
+#endif
+}
+
+void PrefixSumBlock(uint32_t* values, uint32_t base) {
+#ifdef BIT_PACKING_SSE2
+    PrefixSumBlockSse2(values, base);
+#else
+    PrefixSumBlockScalar(values, base);
+#endif
+}
\ No newline at end of file
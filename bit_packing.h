@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Blocks of 128 integers packed with a common bit width in the SIMD-BP128 layout:
+// value i goes to lane i % 4 and every lane is a separate bit stream, so word k of lane l
+// is stored at index 4 * k + l. One 128-bit load then feeds four consecutive values at once.
+// Decoding uses SSE2 when the compiler targets it and a scalar loop over the same layout otherwise
+const size_t PACKED_BLOCK_SIZE = 128;
+
+// number of bits needed to store the largest of count values
+uint8_t RequiredBits(const uint32_t* values, size_t count);
+// 32-bit words taken by a packed block of the given bit width
+size_t PackedBlockWords(uint8_t bits);
+
+// values must hold PACKED_BLOCK_SIZE integers, out receives PackedBlockWords(bits) words
+void PackBlock(const uint32_t* values, uint8_t bits, uint32_t* out);
+// out receives PACKED_BLOCK_SIZE integers
+void UnpackBlock(const uint32_t* in, uint8_t bits, uint32_t* out);
+
+// turns PACKED_BLOCK_SIZE gaps into values: out[i] = base + values[0] + ... + values[i]
+void PrefixSumBlock(uint32_t* values, uint32_t base);
\ No newline at end of file
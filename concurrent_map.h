@@ -1,40 +0,0 @@
-#pragma once
-#include <map>
-#include <mutex>
-#include <string>
-#include <vector>
-
-template <typename Key, typename Value>
-class ConcurrentMap {
-
-public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
-
-    struct Access {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
-    };
-
-    explicit ConcurrentMap(size_t bucket_count) : size_(bucket_count) {
-        vec_mutex_ = std::vector<std::mutex>(size_);
-        vec_bucket_.resize(size_);
-    }
-
-    Access operator[](const Key& key) {
-        uint64_t bucket = key % size_;
-        return { std::lock_guard(vec_mutex_[bucket]), vec_bucket_[bucket][key] };
-    }
-
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (size_t i = 0; i < size_; ++i) {
-            std::lock_guard<std::mutex> guard(vec_mutex_[i]);
-            result.insert(vec_bucket_[i].begin(), vec_bucket_[i].end());
-        }
-        return result;
-    }
-private:
-    std::vector<std::mutex> vec_mutex_;
-    std::vector<std::map<Key, Value>> vec_bucket_;
-    size_t size_;
-};
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "concurrent_search_server.h"
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings)
+{
+    Write([&](SearchServer& server) { server.AddDocument(document_id, document, status, ratings); });
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    Write([&](SearchServer& server) { server.AddDocuments(documents); });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& server) { server.RemoveDocument(document_id); });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    Write([&document_ids](SearchServer& server) { server.RemoveDocuments(document_ids); });
+}
+
+void ConcurrentSearchServer::SetRetrievalMode(RetrievalMode mode) {
+    Write([mode](SearchServer& server) { server.SetRetrievalMode(mode); });
+}
+
+void ConcurrentSearchServer::EnableQueryCache(size_t capacity) {
+    Write([capacity](SearchServer& server) { server.EnableQueryCache(capacity); });
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& server) { return server.GetDocumentCount(); });
+}
+
+std::map<std::string_view, double> ConcurrentSearchServer::GetWordFrequencies(int document_id) const {
+    return Read([document_id](const SearchServer& server) { return server.GetWordFrequencies(document_id); });
+}
+
+ConcurrentSearchServer::ReaderGuard::ReaderGuard(const ConcurrentSearchServer& server)
+    : counter_(server.reader_counters_[server.version_.load()]
+        [std::hash<std::thread::id>{}(std::this_thread::get_id()) % READER_STRIPES].value) {
+    counter_.fetch_add(1);
+}
+
+ConcurrentSearchServer::ReaderGuard::~ReaderGuard() {
+    counter_.fetch_sub(1);
+}
+
+void ConcurrentSearchServer::WaitForReaders() {
+    // a reader registered under one version may have read the old active copy,
+    // so both versions are drained: the unused one first, then the current one
+    const int version = version_.load();
+    WaitUntilNoReaders(1 - version);
+    version_.store(1 - version);
+    WaitUntilNoReaders(version);
+}
+
+void ConcurrentSearchServer::WaitUntilNoReaders(int version) const {
+    for (const ReaderCounter& counter : reader_counters_[version]) {
+        while (counter.value.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
\ No newline at end of file
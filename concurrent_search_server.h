@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "search_server.h"
+
+// search server for many reading threads while documents are added and removed.
+// It is a Left-Right construction: there are two copies of the index, readers use one of them
+// while a writer changes the other, then the copies swap roles. Readers never wait for writers
+// and see every change either completely or not at all. A writer applies each change to both
+// copies and waits only for the readers that still use the copy it is about to change
+class ConcurrentSearchServer {
+public:
+    template <typename... Args>
+    explicit ConcurrentSearchServer(const Args&... args)
+        : replicas_{ std::make_unique<SearchServer>(args...), std::make_unique<SearchServer>(args...) } {
+    }
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+
+    // func gets a const SearchServer& that does not change until it returns,
+    // so several calls inside it see the same version of the index
+    template <typename Func>
+    auto Read(Func func) const {
+        ReaderGuard guard(*this);
+        return func(*replicas_[active_.load()]);
+    }
+
+    // func is called for both copies and must change them in the same way. If it throws,
+    // it must throw before changing anything, as AddDocument and RemoveDocument do
+    template <typename Func>
+    void Write(Func func) {
+        std::lock_guard guard(write_mutex_);
+        const int active = active_.load();
+        func(*replicas_[1 - active]);
+        active_.store(1 - active);
+        WaitForReaders();
+        func(*replicas_[active]);
+    }
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void SetRetrievalMode(RetrievalMode mode);
+    // both copies get a cache of their own
+    void EnableQueryCache(size_t capacity);
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(const Args&... args) const {
+        return Read([&args...](const SearchServer& server) { return server.FindTopDocuments(args...); });
+    }
+    // matched words point into the term dictionary, which only grows, so they stay valid
+    template <typename... Args>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const Args&... args) const {
+        return Read([&args...](const SearchServer& server) { return server.MatchDocument(args...); });
+    }
+    int GetDocumentCount() const;
+    // a copy, the map of SearchServer may be gone after the document is removed
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+private:
+    static constexpr size_t READER_STRIPES = 16;
+
+    // readers of one version count themselves in one of the stripes picked by thread,
+    // so they rarely touch the same cache line
+    struct alignas(64) ReaderCounter {
+        std::atomic<int64_t> value{ 0 };
+    };
+
+    class ReaderGuard {
+    public:
+        explicit ReaderGuard(const ConcurrentSearchServer& server);
+        ReaderGuard(const ReaderGuard&) = delete;
+        ReaderGuard& operator=(const ReaderGuard&) = delete;
+        ~ReaderGuard();
+
+    private:
+        std::atomic<int64_t>& counter_;
+    };
+
+    std::array<std::unique_ptr<SearchServer>, 2> replicas_;
+    // copy used by new readers
+    std::atomic<int> active_{ 0 };
+    // version tells readers which counters to use, writers switch it to wait for older readers
+    std::atomic<int> version_{ 0 };
+    mutable std::array<std::array<ReaderCounter, READER_STRIPES>, 2> reader_counters_;
+    std::mutex write_mutex_;
+
+    void WaitForReaders();
+    void WaitUntilNoReaders(int version) const;
+};
\ No newline at end of file
@@ -1,5 +1,16 @@
+#include <cmath>
 #include  "document.h"
 
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        if (lhs.rating == rhs.rating) {
+            return lhs.id < rhs.id;
+        }
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
 std::ostream& operator<<(std::ostream& os, const Document& doc) {
     os << "{ document_id = " << doc.id
         << ", relevance = " << doc.relevance
@@ -1,5 +1,9 @@
 #pragma once
 #include <iostream>
+#include <string_view>
+#include <vector>
+
+const double EPSILON = 1e-6;
 
 struct Document {
     Document() = default;
@@ -21,5 +25,16 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// one document of a batch for AddDocuments, the text is copied into the server
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// relevances closer than EPSILON are equal, then higher rating wins, then lower id
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
 std::ostream& operator<<(std::ostream& os, const Document& doc);
 void PrintDocument(const Document& document);
\ No newline at end of file
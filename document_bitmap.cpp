@@ -0,0 +1,178 @@
+#include <algorithm>
+#include "document_bitmap.h"
+
+void DocumentBitmap::Add(DocumentOrdinal ordinal) {
+    const size_t key = ordinal >> CHUNK_BITS;
+    const uint16_t value = static_cast<uint16_t>(ordinal);
+    if (chunks_.size() <= key) {
+        chunks_.resize(key + 1);
+    }
+    Chunk& chunk = chunks_[key];
+    if (chunk.IsDense()) {
+        uint64_t& word = chunk.bits[value / 64];
+        const uint64_t bit = uint64_t(1) << (value % 64);
+        if (word & bit) {
+            return;
+        }
+        word |= bit;
+    }
+    else {
+        const auto iter = std::lower_bound(chunk.values.begin(), chunk.values.end(), value);
+        if (iter != chunk.values.end() && *iter == value) {
+            return;
+        }
+        chunk.values.insert(iter, value);
+    }
+    ++chunk.size;
+    ++size_;
+    if (!chunk.IsDense() && chunk.size > MAX_SPARSE_SIZE) {
+        MakeDense(chunk);
+    }
+}
+
+void DocumentBitmap::Remove(DocumentOrdinal ordinal) {
+    const size_t key = ordinal >> CHUNK_BITS;
+    const uint16_t value = static_cast<uint16_t>(ordinal);
+    if (chunks_.size() <= key) {
+        return;
+    }
+    Chunk& chunk = chunks_[key];
+    if (chunk.IsDense()) {
+        uint64_t& word = chunk.bits[value / 64];
+        const uint64_t bit = uint64_t(1) << (value % 64);
+        if (!(word & bit)) {
+            return;
+        }
+        word &= ~bit;
+    }
+    else {
+        const auto iter = std::lower_bound(chunk.values.begin(), chunk.values.end(), value);
+        if (iter == chunk.values.end() || *iter != value) {
+            return;
+        }
+        chunk.values.erase(iter);
+    }
+    --chunk.size;
+    --size_;
+    if (chunk.IsDense() && chunk.size < MIN_DENSE_SIZE) {
+        MakeSparse(chunk);
+    }
+}
+
+bool DocumentBitmap::Contains(DocumentOrdinal ordinal) const {
+    const size_t key = ordinal >> CHUNK_BITS;
+    return key < chunks_.size() && chunks_[key].Contains(static_cast<uint16_t>(ordinal));
+}
+
+bool DocumentBitmap::Intersects(DocumentOrdinal first, DocumentOrdinal last) const {
+    for (size_t key = first >> CHUNK_BITS; key <= last >> CHUNK_BITS && key < chunks_.size(); ++key) {
+        const Chunk& chunk = chunks_[key];
+        if (chunk.size == 0) {
+            continue;
+        }
+        const uint32_t low = key == first >> CHUNK_BITS ? first % CHUNK_SIZE : 0;
+        const uint32_t high = key == last >> CHUNK_BITS ? last % CHUNK_SIZE : CHUNK_SIZE - 1;
+        if (chunk.IsDense()) {
+            const size_t first_word = low / 64;
+            const size_t last_word = high / 64;
+            for (size_t word = first_word; word <= last_word; ++word) {
+                uint64_t mask = ~uint64_t(0);
+                if (word == first_word) {
+                    mask &= ~uint64_t(0) << (low % 64);
+                }
+                if (word == last_word) {
+                    mask &= ~uint64_t(0) >> (63 - high % 64);
+                }
+                if (chunk.bits[word] & mask) {
+                    return true;
+                }
+            }
+        }
+        else {
+            const auto iter = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+            if (iter != chunk.values.end() && *iter <= high) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t DocumentBitmap::Filter(DocumentOrdinal* ordinals, uint32_t* counts, size_t size) const {
+    size_t kept = 0;
+    size_t i = 0;
+    // postings are handled in runs that fall into one chunk
+    while (i < size) {
+        const size_t key = ordinals[i] >> CHUNK_BITS;
+        size_t run_end = i;
+        while (run_end < size && ordinals[run_end] >> CHUNK_BITS == key) {
+            ++run_end;
+        }
+        if (key < chunks_.size() && chunks_[key].size > 0) {
+            const Chunk& chunk = chunks_[key];
+            if (chunk.IsDense()) {
+                // no branch on membership, every posting is written and kept only if its bit is set
+                for (; i < run_end; ++i) {
+                    const uint16_t value = static_cast<uint16_t>(ordinals[i]);
+                    ordinals[kept] = ordinals[i];
+                    counts[kept] = counts[i];
+                    kept += (chunk.bits[value / 64] >> (value % 64)) & 1;
+                }
+            }
+            else {
+                // both sides are sorted, so this is a merge of two lists
+                auto iter = std::lower_bound(chunk.values.begin(), chunk.values.end(), static_cast<uint16_t>(ordinals[i]));
+                for (; i < run_end && iter != chunk.values.end(); ++i) {
+                    const uint16_t value = static_cast<uint16_t>(ordinals[i]);
+                    while (iter != chunk.values.end() && *iter < value) {
+                        ++iter;
+                    }
+                    if (iter != chunk.values.end() && *iter == value) {
+                        ordinals[kept] = ordinals[i];
+                        counts[kept] = counts[i];
+                        ++kept;
+                    }
+                }
+            }
+        }
+        i = run_end;
+    }
+    return kept;
+}
+
+size_t DocumentBitmap::size() const {
+    return size_;
+}
+
+bool DocumentBitmap::Chunk::IsDense() const {
+    return !bits.empty();
+}
+
+bool DocumentBitmap::Chunk::Contains(uint16_t value) const {
+    if (IsDense()) {
+        return (bits[value / 64] >> (value % 64)) & 1;
+    }
+    return std::binary_search(values.begin(), values.end(), value);
+}
+
+void DocumentBitmap::MakeDense(Chunk& chunk) {
+    chunk.bits.assign(CHUNK_SIZE / 64, 0);
+    for (const uint16_t value : chunk.values) {
+        chunk.bits[value / 64] |= uint64_t(1) << (value % 64);
+    }
+    std::vector<uint16_t>().swap(chunk.values);
+}
+
+void DocumentBitmap::MakeSparse(Chunk& chunk) {
+    chunk.values.reserve(chunk.size);
+    for (size_t word = 0; word < chunk.bits.size(); ++word) {
+        for (uint64_t bits = chunk.bits[word]; bits != 0; bits &= bits - 1) {
+            size_t bit = 0;
+            while (!((bits >> bit) & 1)) {
+                ++bit;
+            }
+            chunk.values.push_back(static_cast<uint16_t>(word * 64 + bit));
+        }
+    }
+    std::vector<uint64_t>().swap(chunk.bits);
+}
\ No newline at end of file
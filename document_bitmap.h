@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "posting_list.h"
+
+// set of document ordinals split into chunks of 2^16 ordinals like a Roaring bitmap:
+// a sparse chunk keeps a sorted array of low halves, a dense one switches to a bitset
+class DocumentBitmap {
+public:
+    void Add(DocumentOrdinal ordinal);
+    void Remove(DocumentOrdinal ordinal);
+    bool Contains(DocumentOrdinal ordinal) const;
+
+    // true if some ordinal from [first, last] is in the set
+    bool Intersects(DocumentOrdinal first, DocumentOrdinal last) const;
+    // keeps only postings whose ordinals are in the set, ordinals must be sorted.
+    // Returns the number of postings left at the front of the arrays
+    size_t Filter(DocumentOrdinal* ordinals, uint32_t* counts, size_t size) const;
+
+    size_t size() const;
+
+private:
+    static constexpr uint32_t CHUNK_BITS = 16;
+    static constexpr uint32_t CHUNK_SIZE = uint32_t(1) << CHUNK_BITS;
+    // a chunk becomes dense above MAX_SPARSE_SIZE and sparse again below MIN_DENSE_SIZE,
+    // the gap keeps add/remove at the border from converting it every time
+    static constexpr size_t MAX_SPARSE_SIZE = 4096;
+    static constexpr size_t MIN_DENSE_SIZE = 2048;
+
+    struct Chunk {
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> bits;
+        size_t size = 0;
+
+        bool IsDense() const;
+        bool Contains(uint16_t value) const;
+    };
+
+    // ordinals are dense, so chunks are indexed by the high half directly
+    std::vector<Chunk> chunks_;
+    size_t size_ = 0;
+
+    static void MakeDense(Chunk& chunk);
+    static void MakeSparse(Chunk& chunk);
+};
\ No newline at end of file
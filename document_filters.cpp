@@ -0,0 +1,28 @@
+#include <algorithm>
+#include "document_filters.h"
+
+bool StatusIs::operator()(int, DocumentStatus document_status, int) const {
+    return document_status == status;
+}
+
+bool RatingAtLeast::operator()(int, DocumentStatus, int rating) const {
+    return rating >= min_rating;
+}
+
+IdIn::IdIn(std::vector<int> document_ids)
+    : document_ids_(std::move(document_ids)) {
+    std::sort(document_ids_.begin(), document_ids_.end());
+    document_ids_.erase(std::unique(document_ids_.begin(), document_ids_.end()), document_ids_.end());
+}
+
+bool IdIn::operator()(int document_id, DocumentStatus, int) const {
+    return std::binary_search(document_ids_.begin(), document_ids_.end(), document_id);
+}
+
+const std::vector<int>& IdIn::GetIds() const {
+    return document_ids_;
+}
+
+bool AnyDocument::operator()(int, DocumentStatus, int) const {
+    return true;
+}
\ No newline at end of file
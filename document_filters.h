@@ -0,0 +1,73 @@
+#pragma once
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "document.h"
+
+// predicates FindTopDocuments recognizes at compile time. They can be called like any predicate,
+// but the search checks postings against status bitmaps and attribute columns instead,
+// without a call per posting. Any other callable goes the generic way
+
+struct StatusIs {
+    DocumentStatus status;
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const;
+};
+
+struct RatingAtLeast {
+    int min_rating;
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const;
+};
+
+class IdIn {
+public:
+    explicit IdIn(std::vector<int> document_ids);
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const;
+    // sorted and unique
+    const std::vector<int>& GetIds() const;
+
+private:
+    std::vector<int> document_ids_;
+};
+
+// every document that is not removed
+struct AnyDocument {
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const;
+};
+
+// documents accepted by every filter, e.g. AllOf(StatusIs{ DocumentStatus::ACTUAL }, RatingAtLeast{ 3 })
+template <typename... Filters>
+class AllOf {
+public:
+    explicit AllOf(Filters... filters)
+        : filters_(std::move(filters)...) {
+    }
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const {
+        return std::apply([&](const Filters&... filters) {
+            return (filters(document_id, document_status, rating) && ...);
+        }, filters_);
+    }
+
+    const std::tuple<Filters...>& GetFilters() const {
+        return filters_;
+    }
+
+private:
+    std::tuple<Filters...> filters_;
+};
+
+template <typename DocumentPredicate>
+struct IsDocumentFilter : std::false_type {};
+template <>
+struct IsDocumentFilter<StatusIs> : std::true_type {};
+template <>
+struct IsDocumentFilter<RatingAtLeast> : std::true_type {};
+template <>
+struct IsDocumentFilter<IdIn> : std::true_type {};
+template <>
+struct IsDocumentFilter<AnyDocument> : std::true_type {};
+template <typename... Filters>
+struct IsDocumentFilter<AllOf<Filters...>> : std::conjunction<IsDocumentFilter<Filters>...> {};
\ No newline at end of file
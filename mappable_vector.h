@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// contiguous array that either owns its elements or refers to elements of a loaded snapshot.
+// Referred elements are never changed: Mutable() copies them into an owned vector first,
+// so structures opened from a snapshot keep working as usual ones
+template <typename T>
+class MappableVector {
+public:
+    MappableVector() = default;
+    explicit MappableVector(std::vector<T> elements)
+        : owned_(std::move(elements)) {
+    }
+
+    static MappableVector Refer(const T* data, size_t size) {
+        MappableVector result;
+        result.referred_ = size > 0 ? data : nullptr;
+        result.referred_size_ = size;
+        return result;
+    }
+
+    const T* data() const {
+        return referred_ != nullptr ? referred_ : owned_.data();
+    }
+    size_t size() const {
+        return referred_ != nullptr ? referred_size_ : owned_.size();
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const T* begin() const {
+        return data();
+    }
+    const T* end() const {
+        return data() + size();
+    }
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+    const T& front() const {
+        return data()[0];
+    }
+    const T& back() const {
+        return data()[size() - 1];
+    }
+
+    std::vector<T>& Mutable() {
+        if (referred_ != nullptr) {
+            owned_.assign(referred_, referred_ + referred_size_);
+            referred_ = nullptr;
+            referred_size_ = 0;
+        }
+        return owned_;
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* referred_ = nullptr;
+    size_t referred_size_ = 0;
+};
\ No newline at end of file
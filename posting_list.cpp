@@ -0,0 +1,279 @@
+#include <algorithm>
+#include "posting_list.h"
+
+namespace {
+
+size_t BlockWords(const PostingList::Block& block) {
+    return PackedBlockWords(block.ordinal_bits) + PackedBlockWords(block.count_bits);
+}
+
+} // namespace
+
+void PostingList::Insert(DocumentOrdinal ordinal, uint32_t count, double term_freq) {
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    tail_ordinals_.Mutable().push_back(ordinal);
+    tail_counts_.Mutable().push_back(count);
+    ++size_;
+    tail_max_term_freq_ = std::max(tail_max_term_freq_, term_freq);
+    if (tail_ordinals_.size() == BLOCK_SIZE) {
+        FlushTail();
+    }
+}
+
+bool PostingList::Contains(DocumentOrdinal ordinal) const {
+    const size_t block = FindBlock(ordinal);
+    if (block == GetBlockCount()) {
+        return false;
+    }
+    if (block == blocks_.size()) {
+        return std::binary_search(tail_ordinals_.begin(), tail_ordinals_.end(), ordinal);
+    }
+    if (blocks_[block].first_ordinal > ordinal) {
+        return false;
+    }
+    DocumentOrdinal ordinals[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    const size_t block_size = DecodeBlock(block, ordinals, counts);
+    return std::binary_search(ordinals, ordinals + block_size, ordinal);
+}
+
+size_t PostingList::GetBlockCount() const {
+    return blocks_.size() + (tail_ordinals_.empty() ? 0 : 1);
+}
+
+size_t PostingList::FindBlock(DocumentOrdinal ordinal, size_t first_block) const {
+    if (first_block < blocks_.size()) {
+        const auto iter = std::partition_point(blocks_.begin() + first_block, blocks_.end(),
+            [ordinal](const Block& block) {
+                return block.last_ordinal < ordinal;
+            });
+        if (iter != blocks_.end()) {
+            return iter - blocks_.begin();
+        }
+    }
+    first_block = std::max(first_block, blocks_.size());
+    if (first_block == blocks_.size() && !tail_ordinals_.empty() && tail_ordinals_.back() >= ordinal) {
+        return first_block;
+    }
+    return GetBlockCount();
+}
+
+DocumentOrdinal PostingList::GetBlockFirstOrdinal(size_t block) const {
+    return block < blocks_.size() ? blocks_[block].first_ordinal : tail_ordinals_.front();
+}
+
+DocumentOrdinal PostingList::GetBlockLastOrdinal(size_t block) const {
+    return block < blocks_.size() ? blocks_[block].last_ordinal : tail_ordinals_.back();
+}
+
+double PostingList::GetBlockMaxTermFreq(size_t block) const {
+    return block < blocks_.size() ? blocks_[block].max_term_freq : tail_max_term_freq_;
+}
+
+size_t PostingList::DecodeBlock(size_t block, DocumentOrdinal* ordinals, uint32_t* counts) const {
+    if (block == blocks_.size()) {
+        std::copy(tail_ordinals_.begin(), tail_ordinals_.end(), ordinals);
+        std::copy(tail_counts_.begin(), tail_counts_.end(), counts);
+        return tail_ordinals_.size();
+    }
+    const Block& header = blocks_[block];
+    const uint32_t* packed = packed_.data() + header.offset;
+    UnpackBlock(packed, header.ordinal_bits, ordinals);
+    PrefixSumBlock(ordinals, header.first_ordinal);
+    UnpackBlock(packed + PackedBlockWords(header.ordinal_bits), header.count_bits, counts);
+    // counts are stored minus one, a posting always has at least one occurrence
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        ++counts[i];
+    }
+    return header.size;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+PostingList::Block PostingList::EncodeBlock(const DocumentOrdinal* ordinals, const uint32_t* counts, size_t count,
+    double max_term_freq, std::vector<uint32_t>& packed) const {
+    // a short block is padded with zero gaps, they decode to copies of the last ordinal and are never read
+    uint32_t gaps[BLOCK_SIZE] = {};
+    uint32_t stored_counts[BLOCK_SIZE] = {};
+    for (size_t i = 1; i < count; ++i) {
+        gaps[i] = ordinals[i] - ordinals[i - 1];
+    }
+    for (size_t i = 0; i < count; ++i) {
+        stored_counts[i] = counts[i] - 1;
+    }
+    Block block;
+    block.first_ordinal = ordinals[0];
+    block.last_ordinal = ordinals[count - 1];
+    block.offset = static_cast<uint32_t>(packed.size());
+    block.size = static_cast<uint16_t>(count);
+    block.ordinal_bits = RequiredBits(gaps, count);
+    block.count_bits = RequiredBits(stored_counts, count);
+    block.max_term_freq = max_term_freq;
+    packed.resize(packed.size() + BlockWords(block));
+    PackBlock(gaps, block.ordinal_bits, packed.data() + block.offset);
+    PackBlock(stored_counts, block.count_bits, packed.data() + block.offset + PackedBlockWords(block.ordinal_bits));
+    return block;
+}
+
+void PostingList::FlushTail() {
+    blocks_.Mutable().push_back(EncodeBlock(tail_ordinals_.data(), tail_counts_.data(), tail_ordinals_.size(),
+        tail_max_term_freq_, packed_.Mutable()));
+    tail_ordinals_.Mutable().clear();
+    tail_counts_.Mutable().clear();
+    tail_max_term_freq_ = 0.0;
+}
+
+void PostingList::Save(const std::vector<PostingList>& lists, SnapshotWriter& writer) {
+    std::vector<SnapshotEntry> entries;
+    entries.reserve(lists.size());
+    SnapshotEntry next = {};
+    for (const PostingList& list : lists) {
+        SnapshotEntry entry = next;
+        entry.size = list.size_;
+        entry.tail_max_term_freq = list.tail_max_term_freq_;
+        entry.max_term_freq = list.max_term_freq_;
+        entry.block_count = static_cast<uint32_t>(list.blocks_.size());
+        entry.packed_size = static_cast<uint32_t>(list.packed_.size());
+        entry.tail_size = static_cast<uint32_t>(list.tail_ordinals_.size());
+        entries.push_back(entry);
+        next.block_begin += entry.block_count;
+        next.packed_begin += entry.packed_size;
+        next.tail_begin += entry.tail_size;
+    }
+    writer.WriteArray(entries);
+
+    writer.BeginArray<Block>(next.block_begin);
+    for (const PostingList& list : lists) {
+        writer.WriteElements(list.blocks_.data(), list.blocks_.size());
+    }
+    writer.EndArray();
+    writer.BeginArray<uint32_t>(next.packed_begin);
+    for (const PostingList& list : lists) {
+        writer.WriteElements(list.packed_.data(), list.packed_.size());
+    }
+    writer.EndArray();
+    writer.BeginArray<DocumentOrdinal>(next.tail_begin);
+    for (const PostingList& list : lists) {
+        writer.WriteElements(list.tail_ordinals_.data(), list.tail_ordinals_.size());
+    }
+    writer.EndArray();
+    writer.BeginArray<uint32_t>(next.tail_begin);
+    for (const PostingList& list : lists) {
+        writer.WriteElements(list.tail_counts_.data(), list.tail_counts_.size());
+    }
+    writer.EndArray();
+}
+
+std::vector<PostingList> PostingList::Load(SnapshotReader& reader) {
+    const MappableVector<SnapshotEntry> entries = reader.ReadArray<SnapshotEntry>();
+    const MappableVector<Block> blocks = reader.ReadArray<Block>();
+    const MappableVector<uint32_t> packed = reader.ReadArray<uint32_t>();
+    const MappableVector<DocumentOrdinal> tail_ordinals = reader.ReadArray<DocumentOrdinal>();
+    const MappableVector<uint32_t> tail_counts = reader.ReadArray<uint32_t>();
+    if (tail_ordinals.size() != tail_counts.size()) {
+        throw std::runtime_error("Snapshot is corrupted: posting tails do not match");
+    }
+
+    std::vector<PostingList> lists(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const SnapshotEntry& entry = entries[i];
+        if (entry.block_begin + entry.block_count > blocks.size()
+            || entry.packed_begin + entry.packed_size > packed.size()
+            || entry.tail_begin + entry.tail_size > tail_ordinals.size()) {
+            throw std::runtime_error("Snapshot is corrupted: posting list out of range");
+        }
+        // a mapped snapshot is not checksummed, headers must not lead decoding out of the arrays
+        if (entry.tail_size > BLOCK_SIZE) {
+            throw std::runtime_error("Snapshot is corrupted: posting tail is too long");
+        }
+        for (size_t block = entry.block_begin; block < entry.block_begin + entry.block_count; ++block) {
+            const Block& header = blocks[block];
+            if (header.size == 0 || header.size > BLOCK_SIZE || header.ordinal_bits > 32 || header.count_bits > 32
+                || header.offset + BlockWords(header) > entry.packed_size) {
+                throw std::runtime_error("Snapshot is corrupted: posting block out of range");
+            }
+        }
+        PostingList& list = lists[i];
+        list.blocks_ = MappableVector<Block>::Refer(blocks.data() + entry.block_begin, entry.block_count);
+        list.packed_ = MappableVector<uint32_t>::Refer(packed.data() + entry.packed_begin, entry.packed_size);
+        list.tail_ordinals_ = MappableVector<DocumentOrdinal>::Refer(tail_ordinals.data() + entry.tail_begin, entry.tail_size);
+        list.tail_counts_ = MappableVector<uint32_t>::Refer(tail_counts.data() + entry.tail_begin, entry.tail_size);
+        list.tail_max_term_freq_ = entry.tail_max_term_freq;
+        list.max_term_freq_ = entry.max_term_freq;
+        list.size_ = static_cast<size_t>(entry.size);
+    }
+    return lists;
+}
+
+bool PostingList::HasOrdinalsBelow(size_t ordinal_count) const {
+    for (const Block& block : blocks_) {
+        if (block.first_ordinal > block.last_ordinal || block.last_ordinal >= ordinal_count) {
+            return false;
+        }
+    }
+    return std::all_of(tail_ordinals_.begin(), tail_ordinals_.end(), [ordinal_count](DocumentOrdinal ordinal) {
+        return ordinal < ordinal_count;
+    });
+}
+
+PostingCursor::PostingCursor(const PostingList& postings)
+    : postings_(&postings) {
+    LoadBlock(0);
+}
+
+bool PostingCursor::IsEnd() const {
+    return block_ >= postings_->GetBlockCount();
+}
+
+DocumentOrdinal PostingCursor::GetOrdinal() const {
+    return ordinals_[position_];
+}
+
+uint32_t PostingCursor::GetCount() const {
+    return counts_[position_];
+}
+
+void PostingCursor::Next() {
+    if (++position_ == block_size_) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void PostingCursor::NextGeq(DocumentOrdinal target) {
+    if (IsEnd() || ordinals_[position_] >= target) {
+        return;
+    }
+    // skip headers tell which block holds the target, only that block is decoded
+    if (postings_->GetBlockLastOrdinal(block_) < target) {
+        LoadBlock(postings_->FindBlock(target, block_ + 1));
+        if (IsEnd()) {
+            return;
+        }
+    }
+    position_ = std::lower_bound(ordinals_ + position_, ordinals_ + block_size_, target) - ordinals_;
+}
+
+double PostingCursor::GetBlockMaxTermFreq(DocumentOrdinal target) {
+    const size_t block_count = postings_->GetBlockCount();
+    shallow_block_ = std::max(shallow_block_, block_);
+    while (shallow_block_ < block_count && postings_->GetBlockLastOrdinal(shallow_block_) < target) {
+        ++shallow_block_;
+    }
+    return shallow_block_ < block_count ? postings_->GetBlockMaxTermFreq(shallow_block_) : 0.0;
+}
+
+void PostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    position_ = 0;
+    block_size_ = block < postings_->GetBlockCount() ? postings_->DecodeBlock(block, ordinals_, counts_) : 0;
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "bit_packing.h"
+#include "mappable_vector.h"
+#include "snapshot_io.h"
+
+using DocumentOrdinal = uint32_t;
+
+// postings of a single term: document ordinals sorted ascending with the number of times
+// the term occurs in the document.
+// Full blocks of BLOCK_SIZE postings are compressed: ordinal gaps and counts are bit-packed
+// with per-block widths. Newest postings wait in an uncompressed tail until a block is filled.
+// Every block remembers its maximal term frequency for dynamic pruning
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = PACKED_BLOCK_SIZE;
+
+    // skip header of a compressed block
+    struct Block {
+        DocumentOrdinal first_ordinal;
+        DocumentOrdinal last_ordinal;
+        uint32_t offset;
+        uint16_t size;
+        uint8_t ordinal_bits;
+        uint8_t count_bits;
+        double max_term_freq;
+    };
+
+    // ordinals are handed out in increasing order, so ordinal must be greater than any in the list.
+    // term_freq is only used to keep block bounds, the list stores count
+    void Insert(DocumentOrdinal ordinal, uint32_t count, double term_freq);
+    bool Contains(DocumentOrdinal ordinal) const;
+
+    // the tail counts as the last block
+    size_t GetBlockCount() const;
+    // first block from first_block on whose last ordinal is not less than ordinal
+    size_t FindBlock(DocumentOrdinal ordinal, size_t first_block = 0) const;
+    DocumentOrdinal GetBlockFirstOrdinal(size_t block) const;
+    DocumentOrdinal GetBlockLastOrdinal(size_t block) const;
+    double GetBlockMaxTermFreq(size_t block) const;
+    // fills BLOCK_SIZE-sized buffers, returns the number of postings in the block
+    size_t DecodeBlock(size_t block, DocumentOrdinal* ordinals, uint32_t* counts) const;
+
+    // the largest term frequency of any posting in the list
+    double GetMaxTermFreq() const;
+
+    template <typename Func>
+    void ForEach(Func func) const;
+    // only postings with ordinals from first_ordinal to last_ordinal inclusive, blocks outside are not decoded
+    template <typename Func>
+    void ForEachInRange(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal, Func func) const;
+
+    size_t size() const;
+    bool empty() const;
+
+    // all lists go to a few shared arrays, loaded lists refer to them without copying
+    static void Save(const std::vector<PostingList>& lists, SnapshotWriter& writer);
+    static std::vector<PostingList> Load(SnapshotReader& reader);
+    // block bounds and tail ordinals of a loaded list lie below ordinal_count, packed gaps are not decoded
+    bool HasOrdinalsBelow(size_t ordinal_count) const;
+
+private:
+    // where the arrays of one list start in the shared arrays of a snapshot
+    struct SnapshotEntry {
+        uint64_t block_begin;
+        uint64_t packed_begin;
+        uint64_t tail_begin;
+        uint64_t size;
+        double tail_max_term_freq;
+        double max_term_freq;
+        uint32_t block_count;
+        uint32_t packed_size;
+        uint32_t tail_size;
+        uint32_t reserved;
+    };
+
+    MappableVector<Block> blocks_;
+    MappableVector<uint32_t> packed_;
+    MappableVector<DocumentOrdinal> tail_ordinals_;
+    MappableVector<uint32_t> tail_counts_;
+    double tail_max_term_freq_ = 0.0;
+    double max_term_freq_ = 0.0;
+    size_t size_ = 0;
+
+    Block EncodeBlock(const DocumentOrdinal* ordinals, const uint32_t* counts, size_t count, double max_term_freq,
+        std::vector<uint32_t>& packed) const;
+    void FlushTail();
+};
+
+template <typename Func>
+void PostingList::ForEach(Func func) const {
+    DocumentOrdinal ordinals[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    for (size_t block = 0; block < blocks_.size(); ++block) {
+        const size_t block_size = DecodeBlock(block, ordinals, counts);
+        for (size_t i = 0; i < block_size; ++i) {
+            func(ordinals[i], counts[i]);
+        }
+    }
+    for (size_t i = 0; i < tail_ordinals_.size(); ++i) {
+        func(tail_ordinals_[i], tail_counts_[i]);
+    }
+}
+
+template <typename Func>
+void PostingList::ForEachInRange(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal, Func func) const {
+    DocumentOrdinal ordinals[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    for (size_t block = FindBlock(first_ordinal); block < GetBlockCount() && GetBlockFirstOrdinal(block) <= last_ordinal; ++block) {
+        const size_t block_size = DecodeBlock(block, ordinals, counts);
+        for (size_t i = 0; i < block_size && ordinals[i] <= last_ordinal; ++i) {
+            if (ordinals[i] >= first_ordinal) {
+                func(ordinals[i], counts[i]);
+            }
+        }
+    }
+}
+
+// walks a posting list forward block by block, used by document-at-a-time retrieval
+class PostingCursor {
+public:
+    explicit PostingCursor(const PostingList& postings);
+
+    bool IsEnd() const;
+    DocumentOrdinal GetOrdinal() const;
+    uint32_t GetCount() const;
+
+    void Next();
+    // moves to the first posting with ordinal not less than target
+    void NextGeq(DocumentOrdinal target);
+    // maximal term frequency of the block that could contain target, nothing is decoded
+    double GetBlockMaxTermFreq(DocumentOrdinal target);
+
+private:
+    const PostingList* postings_;
+    size_t block_ = 0;
+    size_t block_size_ = 0;
+    size_t position_ = 0;
+    size_t shallow_block_ = 0;
+    DocumentOrdinal ordinals_[PostingList::BLOCK_SIZE];
+    uint32_t counts_[PostingList::BLOCK_SIZE];
+
+    void LoadBlock(size_t block);
+};
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include <algorithm>
 #include <execution>
-#include <list>
+#include <numeric>
 #include <string>
 #include <vector>
 #include "process_queries.h"
@@ -9,21 +9,33 @@ std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries)
 {
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(),
-        [&search_server](const std::string& query) { return search_server.FindTopDocuments(query); });
+    return search_server.FindTopDocumentsBatch(queries);
+}
 
-    return result;
+std::vector<Document>::const_iterator JoinedDocuments::begin() const {
+    return documents.begin();
+}
+
+std::vector<Document>::const_iterator JoinedDocuments::end() const {
+    return documents.end();
+}
+
+size_t JoinedDocuments::size() const {
+    return documents.size();
 }
 
-std::list<Document> ProcessQueriesJoined(
+JoinedDocuments ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries)
 {
-    auto temp = ProcessQueries(search_server, queries);
-    std::list<Document> result;
-    for (auto& vec : temp) {
-        result.insert(result.end(), vec.begin(), vec.end());
-    }
+    JoinedDocuments result;
+    search_server.FindTopDocumentsBatchJoined(queries, result.documents, result.offsets);
     return result;
+}
+
+std::vector<std::vector<Document>> ProcessQueries(
+    const ConcurrentSearchServer& search_server,
+    const std::vector<std::string>& queries)
+{
+    return search_server.Read([&queries](const SearchServer& server) { return ProcessQueries(server, queries); });
 }
\ No newline at end of file
@@ -1,12 +1,31 @@
 #pragma once
-#include <list>
+#include <string>
+#include <vector>
+#include "concurrent_search_server.h"
 #include "document.h"
 #include "search_server.h"
 
+// queries with the same terms are answered once, the batch is balanced by the length of posting lists
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(
+// documents found for all queries one after another in a single array,
+// results of query i take [offsets[i], offsets[i + 1])
+struct JoinedDocuments {
+    std::vector<Document> documents;
+    std::vector<size_t> offsets;
+
+    std::vector<Document>::const_iterator begin() const;
+    std::vector<Document>::const_iterator end() const;
+    size_t size() const;
+};
+
+JoinedDocuments ProcessQueriesJoined(
     const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// every query of the batch sees the same version of the index, writers do not wait for the batch to start
+std::vector<std::vector<Document>> ProcessQueries(
+    const ConcurrentSearchServer& search_server,
     const std::vector<std::string>& queries);
\ No newline at end of file
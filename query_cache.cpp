@@ -0,0 +1,83 @@
+#include <stdexcept>
+#include "query_cache.h"
+
+bool QueryCacheKey::operator==(const QueryCacheKey& other) const {
+    return status == other.status && max_document_count == other.max_document_count
+        && plus_terms == other.plus_terms && minus_terms == other.minus_terms;
+}
+
+QueryCache::QueryCache(size_t capacity, size_t shard_count)
+    : shard_count_(shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Query cache must have at least one shard");
+    }
+    shard_capacity_ = (capacity + shard_count - 1) / shard_count;
+    shards_.reset(new Shard[shard_count]);
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const QueryCacheKey& key, uint64_t generation) {
+    Shard& shard = GetShard(KeyHash{}(key));
+    std::lock_guard guard(shard.mutex);
+    const auto index_iter = shard.index.find(key);
+    if (index_iter == shard.index.end()) {
+        ++misses_;
+        return std::nullopt;
+    }
+    const auto entry_iter = index_iter->second;
+    if (entry_iter->second.generation != generation) {
+        shard.index.erase(index_iter);
+        shard.entries.erase(entry_iter);
+        ++misses_;
+        return std::nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry_iter);
+    ++hits_;
+    return entry_iter->second.documents;
+}
+
+void QueryCache::Insert(QueryCacheKey key, uint64_t generation, std::vector<Document> documents) {
+    if (shard_capacity_ == 0) {
+        return;
+    }
+    Shard& shard = GetShard(KeyHash{}(key));
+    std::lock_guard guard(shard.mutex);
+    const auto index_iter = shard.index.find(key);
+    if (index_iter != shard.index.end()) {
+        // another thread computed the same query meanwhile
+        index_iter->second->second = { generation, std::move(documents) };
+        shard.entries.splice(shard.entries.begin(), shard.entries, index_iter->second);
+        return;
+    }
+    if (shard.entries.size() >= shard_capacity_) {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+    }
+    shard.entries.emplace_front(std::move(key), Entry{ generation, std::move(documents) });
+    shard.index.emplace(shard.entries.front().first, shard.entries.begin());
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+    return { hits_.load(), misses_.load() };
+}
+
+size_t QueryCache::KeyHash::operator()(const QueryCacheKey& key) const {
+    uint64_t hash = static_cast<uint64_t>(key.status) * 0x9E3779B97F4A7C15 + key.max_document_count;
+    const auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0xFF51AFD7ED558CCD;
+        hash ^= hash >> 32;
+    };
+    for (const TermId term_id : key.plus_terms) {
+        mix(term_id);
+    }
+    // minus terms are told apart from plus ones by the separator
+    mix(~uint64_t(0));
+    for (const TermId term_id : key.minus_terms) {
+        mix(term_id);
+    }
+    return static_cast<size_t>(hash);
+}
+
+QueryCache::Shard& QueryCache::GetShard(size_t hash) {
+    // high bits pick the shard, the map of the shard uses all of them
+    return shards_[(hash >> 48) % shard_count_];
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+#include "term_dictionary.h"
+
+// a parsed query: terms are sorted and unique, so different spellings of one query share a key
+struct QueryCacheKey {
+    std::vector<TermId> plus_terms;
+    std::vector<TermId> minus_terms;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    size_t max_document_count = 0;
+
+    bool operator==(const QueryCacheKey& other) const;
+};
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// LRU cache of search results split into shards with their own locks, so parallel queries rarely meet.
+// Every entry remembers the generation of the index it was computed for, entries of older
+// generations are misses and are dropped when found
+class QueryCache {
+public:
+    static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+    // capacity is split evenly between the shards, a zero capacity keeps nothing
+    explicit QueryCache(size_t capacity, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    std::optional<std::vector<Document>> Find(const QueryCacheKey& key, uint64_t generation);
+    void Insert(QueryCacheKey key, uint64_t generation, std::vector<Document> documents);
+
+    QueryCacheStats GetStats() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const QueryCacheKey& key) const;
+    };
+    struct Entry {
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+    // the list keeps keys from the most recently used one, the map points into it
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::pair<QueryCacheKey, Entry>> entries;
+        std::unordered_map<QueryCacheKey, std::list<std::pair<QueryCacheKey, Entry>>::iterator, KeyHash> index;
+    };
+
+    size_t shard_capacity_;
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> hits_{ 0 };
+    std::atomic<uint64_t> misses_{ 0 };
+
+    Shard& GetShard(size_t hash);
+};
\ No newline at end of file
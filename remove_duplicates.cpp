@@ -1,25 +1,182 @@
+#include <algorithm>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
 #include "remove_duplicates.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-    std::map<std::set<std::string_view>, int> words_in_docs;
-    std::vector<int> duplicates_to_remove;
+namespace {
 
-    duplicates_to_remove.reserve(search_server.GetDocumentCount());
-    for (auto iter_id = search_server.begin(); iter_id != search_server.end(); ++iter_id) {
-        std::set<std::string_view> words;
-        for (auto& [word, _] : search_server.GetWordFrequencies(*iter_id)) {
-            words.insert(word);
+// finalizer of SplitMix64, close term ids get unrelated hashes
+uint64_t MixBits(uint64_t value) {
+    value += 0x9E3779B97F4A7C15;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+    return value ^ (value >> 31);
+}
+
+void GetTerms(const SearchServer& search_server, int document_id, std::vector<TermId>& terms) {
+    terms.clear();
+    search_server.ForEachDocumentTerm(document_id, [&terms](TermId term_id) { terms.push_back(term_id); });
+}
+
+// both sets are sorted
+double ComputeJaccardSimilarity(const std::vector<TermId>& lhs, const std::vector<TermId>& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    auto lhs_iter = lhs.begin();
+    auto rhs_iter = rhs.begin();
+    while (lhs_iter != lhs.end() && rhs_iter != rhs.end()) {
+        if (*lhs_iter < *rhs_iter) {
+            ++lhs_iter;
+        }
+        else if (*rhs_iter < *lhs_iter) {
+            ++rhs_iter;
+        }
+        else {
+            ++common;
+            ++lhs_iter;
+            ++rhs_iter;
+        }
+    }
+    return static_cast<double>(common) / static_cast<double>(lhs.size() + rhs.size() - common);
+}
+
+std::vector<int> FindExactDuplicates(const SearchServer& search_server, const std::vector<int>& document_ids) {
+    // a sum of term hashes does not depend on the order of terms, so equal sets get equal fingerprints
+    std::vector<uint64_t> fingerprints(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+        [&search_server](int document_id) {
+            uint64_t fingerprint = 0;
+            search_server.ForEachDocumentTerm(document_id, [&fingerprint](TermId term_id) {
+                fingerprint += MixBits(term_id);
+            });
+            return fingerprint;
+        });
+
+    // documents with equal fingerprints become neighbours in the order of ids
+    std::vector<size_t> order(document_ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(std::execution::par, order.begin(), order.end(),
+        [&fingerprints](size_t lhs, size_t rhs) {
+            return fingerprints[lhs] != fingerprints[rhs] ? fingerprints[lhs] < fingerprints[rhs] : lhs < rhs;
+        });
+
+    std::vector<int> duplicates;
+    std::vector<std::vector<TermId>> originals;
+    std::vector<TermId> terms;
+    for (size_t run_begin = 0; run_begin < order.size();) {
+        size_t run_end = run_begin + 1;
+        while (run_end < order.size() && fingerprints[order[run_end]] == fingerprints[order[run_begin]]) {
+            ++run_end;
+        }
+        // equal fingerprints may still be a collision, so the sets themselves are compared
+        if (run_end - run_begin > 1) {
+            originals.clear();
+            for (size_t i = run_begin; i < run_end; ++i) {
+                GetTerms(search_server, document_ids[order[i]], terms);
+                if (std::find(originals.begin(), originals.end(), terms) != originals.end()) {
+                    duplicates.push_back(document_ids[order[i]]);
+                }
+                else {
+                    originals.push_back(terms);
+                }
+            }
         }
-        
-        if (words_in_docs.count(words) != 0) {
-            duplicates_to_remove.push_back(*iter_id);
-        } else {
-            words_in_docs.insert({words, *iter_id});
+        run_begin = run_end;
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, const std::vector<int>& document_ids,
+    const DuplicateSearchOptions& options)
+{
+    const size_t band_count = options.band_count;
+    const size_t rows_per_band = band_count == 0 ? 0 : options.hash_count / band_count;
+    if (rows_per_band == 0) {
+        throw std::invalid_argument("MinHash needs at least one hash per LSH band");
+    }
+    std::vector<uint64_t> seeds(rows_per_band * band_count);
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        seeds[i] = MixBits(i + 1);
+    }
+
+    // a band key stands for rows_per_band minimums of the signature, documents with an equal key are candidates
+    std::vector<uint64_t> band_keys(document_ids.size() * band_count);
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(),
+        [&](size_t index) {
+            std::vector<uint64_t> signature(seeds.size(), std::numeric_limits<uint64_t>::max());
+            search_server.ForEachDocumentTerm(document_ids[index], [&](TermId term_id) {
+                const uint64_t term_hash = MixBits(term_id);
+                for (size_t i = 0; i < seeds.size(); ++i) {
+                    signature[i] = std::min(signature[i], MixBits(term_hash ^ seeds[i]));
+                }
+            });
+            for (size_t band = 0; band < band_count; ++band) {
+                uint64_t key = band;
+                for (size_t row = 0; row < rows_per_band; ++row) {
+                    key = MixBits(key ^ signature[band * rows_per_band + row]);
+                }
+                band_keys[index * band_count + band] = key;
+            }
+        });
+
+    // documents go in the order of ids, each one is checked against the kept documents sharing a band with it.
+    // Only kept documents get into buckets, so copies of one document are compared with the first one only
+    std::vector<std::unordered_map<uint64_t, std::vector<size_t>>> band_buckets(band_count);
+    std::vector<size_t> last_checked_by(document_ids.size(), std::numeric_limits<size_t>::max());
+    std::vector<int> duplicates;
+    std::vector<TermId> terms;
+    std::vector<TermId> kept_terms;
+    for (size_t index = 0; index < document_ids.size(); ++index) {
+        GetTerms(search_server, document_ids[index], terms);
+        bool is_duplicate = false;
+        for (size_t band = 0; band < band_count && !is_duplicate; ++band) {
+            const auto bucket_iter = band_buckets[band].find(band_keys[index * band_count + band]);
+            if (bucket_iter == band_buckets[band].end()) {
+                continue;
+            }
+            for (const size_t kept_index : bucket_iter->second) {
+                if (last_checked_by[kept_index] == index) {
+                    continue;
+                }
+                last_checked_by[kept_index] = index;
+                GetTerms(search_server, document_ids[kept_index], kept_terms);
+                if (ComputeJaccardSimilarity(terms, kept_terms) >= options.similarity_threshold) {
+                    is_duplicate = true;
+                    break;
+                }
+            }
+        }
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[index]);
+            continue;
+        }
+        for (size_t band = 0; band < band_count; ++band) {
+            band_buckets[band][band_keys[index * band_count + band]].push_back(index);
         }
-        
     }
-    for (int duplicate : duplicates_to_remove) {
-        std::cout << "Found duplicate document id " << duplicate << std::endl;
-        search_server.RemoveDocument(duplicate);
+    return duplicates;
+}
+
+} // namespace
+
+std::vector<int> FindDuplicates(const SearchServer& search_server, const DuplicateSearchOptions& options) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    if (options.similarity_threshold >= 1.0) {
+        return FindExactDuplicates(search_server, document_ids);
     }
+    return FindNearDuplicates(search_server, document_ids, options);
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server, const DuplicateSearchOptions& options) {
+    std::vector<int> duplicates = FindDuplicates(search_server, options);
+    search_server.RemoveDocuments(duplicates);
+    return duplicates;
 }
\ No newline at end of file
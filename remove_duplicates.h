@@ -1,8 +1,19 @@
 #pragma once
-#include <iostream>
-#include <map>
-#include <set>
-#include <string>
+#include <vector>
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+struct DuplicateSearchOptions {
+    // 1.0 finds documents with exactly the same set of words. A lower threshold also finds
+    // near duplicates: documents whose word sets have Jaccard similarity not less than it
+    double similarity_threshold = 1.0;
+    // near duplicates only: length of MinHash signatures and the number of LSH bands they are cut into.
+    // Fewer rows in a band find more candidate pairs at a lower similarity
+    size_t hash_count = 128;
+    size_t band_count = 32;
+};
+
+// ids of documents that repeat a document with a smaller id, sorted
+std::vector<int> FindDuplicates(const SearchServer& search_server, const DuplicateSearchOptions& options = {});
+
+// removes the documents FindDuplicates finds and returns their ids
+std::vector<int> RemoveDuplicates(SearchServer& search_server, const DuplicateSearchOptions& options = {});
\ No newline at end of file
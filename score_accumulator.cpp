@@ -0,0 +1,56 @@
+#include <algorithm>
+#include "score_accumulator.h"
+
+void ScoreAccumulator::Grow(size_t ordinal_count) {
+    if (scores_.size() < ordinal_count) {
+        scores_.resize(ordinal_count);
+        flags_.resize(ordinal_count);
+    }
+}
+
+bool ScoreAccumulator::Add(DocumentOrdinal ordinal, double score) {
+    if (flags_[ordinal] & EXCLUDED) {
+        return false;
+    }
+    scores_[ordinal] += ToFixedPoint(score);
+    if (flags_[ordinal] & TOUCHED) {
+        return false;
+    }
+    flags_[ordinal] = TOUCHED;
+    return true;
+}
+
+void ScoreAccumulator::Exclude(DocumentOrdinal ordinal) {
+    flags_[ordinal] = EXCLUDED;
+}
+
+void ScoreAccumulator::Reset(DocumentOrdinal ordinal) {
+    scores_[ordinal] = 0;
+    flags_[ordinal] = 0;
+}
+
+void ScoreAccumulator::Clear() {
+    std::fill(scores_.begin(), scores_.end(), 0);
+    std::fill(flags_.begin(), flags_.end(), 0);
+}
+
+void ScoreAccumulator::Release() {
+    std::vector<uint64_t>().swap(scores_);
+    std::vector<uint8_t>().swap(flags_);
+}
+
+size_t ScoreAccumulator::GetSlotCount() const {
+    return scores_.size();
+}
+
+double ScoreAccumulator::GetScore(DocumentOrdinal ordinal) const {
+    return FromFixedPoint(scores_[ordinal]);
+}
+
+uint64_t ScoreAccumulator::ToFixedPoint(double score) {
+    return static_cast<uint64_t>(score * FIXED_POINT_SCALE + 0.5);
+}
+
+double ScoreAccumulator::FromFixedPoint(uint64_t score) {
+    return score / FIXED_POINT_SCALE;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "posting_list.h"
+
+// relevance of every document slot indexed by ordinal.
+// Scores are summed as fixed-point integers, so the result does not depend on the order
+// in which words add their parts and every way of searching gives the same relevance.
+// The accumulator only grows: a query resets the slots it used, so the next one starts from zeros
+// without clearing or allocating the whole array
+class ScoreAccumulator {
+public:
+    // makes room for ordinals below ordinal_count, existing slots keep their values
+    void Grow(size_t ordinal_count);
+
+    // returns true for the call that touched the ordinal first, excluded ordinals get nothing
+    bool Add(DocumentOrdinal ordinal, double score);
+    void Exclude(DocumentOrdinal ordinal);
+    void Reset(DocumentOrdinal ordinal);
+    // zeroes every slot, for when the touched ones are not known
+    void Clear();
+    // frees the memory of the slots, the next Grow allocates them again
+    void Release();
+    size_t GetSlotCount() const;
+
+    double GetScore(DocumentOrdinal ordinal) const;
+
+    // the same conversion must be used by every way of scoring for results to match exactly
+    static uint64_t ToFixedPoint(double score);
+    static double FromFixedPoint(uint64_t score);
+
+private:
+    static constexpr double FIXED_POINT_SCALE = static_cast<double>(uint64_t(1) << 40);
+    static constexpr uint8_t TOUCHED = 1;
+    static constexpr uint8_t EXCLUDED = 2;
+
+    std::vector<uint64_t> scores_;
+    std::vector<uint8_t> flags_;
+};
\ No newline at end of file
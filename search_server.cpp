@@ -1,66 +1,252 @@
+#include <filesystem>
 #include "search_server.h"
 
 // ===================== Public ===================== 
 
 bool SearchServer::IsValidWord(const std::string_view& word) {
-    return std::none_of(word.begin(), word.end(), [](char ch) { return ch >= '\0' && ch < ' '; });
+    return HasNoControlCharacters(word);
 }
 
 void SearchServer::AddDocument(int document_id, const std::string_view& document,
     DocumentStatus status, const std::vector<int>& ratings)
 {
-    if (document_id < 0) {
-        throw std::invalid_argument("Document's ID must not be negative");
+    ThrowIfReadOnly();
+    SearchServer::CheckNewDocumentId(document_id);
+    // words are split and checked in one pass, the buffer keeps its memory between documents
+    if (!SplitIntoWordsView(document, word_buffer_)) {
+        throw std::invalid_argument("Document data must not contain control characters");
     }
-    if (documents_.count(document_id)) {
-        throw std::invalid_argument("Document's ID must not already exist");
+    const std::vector<std::string_view>& words = word_buffer_;
+    if (log_) {
+        log_->AppendAdd(log_sequence_ + 1, document_id, document, status, ratings);
     }
+    ++log_sequence_;
 
-    documents_.emplace(document_id,
-        SearchServer::DocumentData{ SearchServer::ComputeAverageRating(ratings), status, std::string(document) });
-
-    const std::vector<std::string_view> words = SearchServer::SplitIntoWordsNoStop(documents_.at(document_id).text);
+    // one dictionary lookup per word both interns it and tells a stop word
+    std::vector<TermId> term_ids;
+    term_ids.reserve(words.size());
     for (const std::string_view& word : words) {
-        if (!IsValidWord(word)) {
-            documents_.erase(document_id);
-            throw std::invalid_argument("Document data must not contain control characters");
+        const TermId term_id = terms_.Add(word);
+        if (!terms_.IsStopWord(term_id)) {
+            term_ids.push_back(term_id);
         }
     }
+    std::sort(term_ids.begin(), term_ids.end());
+    std::vector<TermCount> term_counts;
+    for (const TermId term_id : term_ids) {
+        if (term_counts.empty() || term_counts.back().term_id != term_id) {
+            term_counts.push_back({ term_id, 0 });
+        }
+        ++term_counts.back().count;
+    }
 
-    const double inv_word_count = 1.0 / words.size();
-    for (const std::string_view& word : words) {
-        word_to_id_freq_[word][document_id] += inv_word_count;
-        id_to_word_freq_[document_id][word] += inv_word_count;
+    const DocumentOrdinal ordinal = SearchServer::StoreDocument(document_id, document, status, ratings, term_counts,
+        static_cast<uint32_t>(term_ids.size()));
+    for (const TermCount& term : term_counts) {
+        // computed exactly as at search time, so block maxima bound the scores
+        postings_[term.term_id].Insert(ordinal, term.count, term.count * ordinal_to_inv_word_count_[ordinal]);
     }
+}
 
-    documents_ids_.insert(document_id);
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    ThrowIfReadOnly();
+    std::vector<int> batch_ids;
+    batch_ids.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        SearchServer::CheckNewDocumentId(document.id);
+        batch_ids.push_back(document.id);
+    }
+    std::sort(batch_ids.begin(), batch_ids.end());
+    if (std::adjacent_find(batch_ids.begin(), batch_ids.end()) != batch_ids.end()) {
+        throw std::invalid_argument("Document's ID must not already exist");
+    }
+
+    // documents are tokenized in parallel; the dictionary is only read here, so stop words
+    // are dropped and words counted without any lock. Words are interned afterwards
+    struct TokenizedDocument {
+        std::vector<std::pair<std::string_view, uint32_t>> word_counts;
+        uint32_t word_count = 0;
+        bool is_valid = true;
+    };
+    std::vector<TokenizedDocument> tokenized(documents.size());
+    std::transform(std::execution::par, documents.begin(), documents.end(), tokenized.begin(),
+        [this](const NewDocument& document) {
+            TokenizedDocument result;
+            std::vector<std::string_view> words;
+            if (!SplitIntoWordsView(document.text, words)) {
+                result.is_valid = false;
+                return result;
+            }
+            std::sort(words.begin(), words.end());
+            for (const std::string_view word : words) {
+                if (!result.word_counts.empty() && result.word_counts.back().first == word) {
+                    ++result.word_counts.back().second;
+                    ++result.word_count;
+                    continue;
+                }
+                const std::optional<TermId> term_id = terms_.Find(word);
+                if (!term_id || !terms_.IsStopWord(*term_id)) {
+                    result.word_counts.emplace_back(word, 1);
+                    ++result.word_count;
+                }
+            }
+            return result;
+        });
+    // nothing is changed before the whole batch is known to be valid
+    if (std::any_of(tokenized.begin(), tokenized.end(), [](const TokenizedDocument& document) { return !document.is_valid; })) {
+        throw std::invalid_argument("Document data must not contain control characters");
+    }
+
+    struct NewPosting {
+        TermId term_id;
+        DocumentOrdinal ordinal;
+        uint32_t count;
+    };
+    // the whole batch is logged before the first document is stored, a failed append changes nothing
+    if (log_) {
+        log_->AppendAdds(log_sequence_ + 1, documents);
+    }
+    log_sequence_ += documents.size();
+
+    std::vector<NewPosting> new_postings;
+    std::vector<TermCount> term_counts;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const NewDocument& document = documents[i];
+
+        term_counts.clear();
+        for (const auto& [word, count] : tokenized[i].word_counts) {
+            term_counts.push_back({ terms_.Add(word), count });
+        }
+        std::sort(term_counts.begin(), term_counts.end(),
+            [](const TermCount& lhs, const TermCount& rhs) { return lhs.term_id < rhs.term_id; });
+        const DocumentOrdinal ordinal = SearchServer::StoreDocument(document.id, document.text, document.status,
+            document.ratings, term_counts, tokenized[i].word_count);
+        for (const TermCount& term : term_counts) {
+            new_postings.push_back({ term.term_id, ordinal, term.count });
+        }
+    }
+
+    // postings are grouped by term with a counting sort, in each group they keep the order of ordinals.
+    // New ordinals are above all old ones, so every list gets its postings appended in parallel
+    std::vector<size_t> term_ends(terms_.size() + 1, 0);
+    for (const NewPosting& posting : new_postings) {
+        ++term_ends[posting.term_id + 1];
+    }
+    std::partial_sum(term_ends.begin(), term_ends.end(), term_ends.begin());
+    std::vector<size_t> positions(term_ends.begin(), term_ends.end() - 1);
+    std::vector<NewPosting> grouped(new_postings.size());
+    for (const NewPosting& posting : new_postings) {
+        grouped[positions[posting.term_id]++] = posting;
+    }
+    std::vector<TermId> touched_terms;
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (term_ends[term_id] != term_ends[term_id + 1]) {
+            touched_terms.push_back(term_id);
+        }
+    }
+    std::for_each(std::execution::par, touched_terms.begin(), touched_terms.end(),
+        [this, &grouped, &term_ends](TermId term_id) {
+            const auto begin = grouped.begin() + term_ends[term_id];
+            const auto end = grouped.begin() + term_ends[term_id + 1];
+            for (auto posting = begin; posting != end; ++posting) {
+                postings_[term_id].Insert(posting->ordinal, posting->count, posting->count * ordinal_to_inv_word_count_[posting->ordinal]);
+            }
+        });
 }
 
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    return static_cast<int>(document_to_ordinal_.size());
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+    DocumentStatus status, size_t max_document_count) const
+{
+    const QueryBatch batch = SearchServer::PlanQueryBatch(raw_queries);
+    std::vector<std::vector<Document>> unique_results(batch.unique_queries.size());
+    std::for_each(std::execution::par, batch.schedule.begin(), batch.schedule.end(),
+        [&](size_t unique_index) {
+            unique_results[unique_index] = WithQueryContext([&](QueryContext& context) {
+                QueryContext::Lease lease(context);
+                return FindTopDocumentsForQuery(std::execution::seq, context, batch.queries[batch.unique_queries[unique_index]],
+                    StatusIs{ status }, max_document_count);
+            });
+        });
+
+    std::vector<std::vector<Document>> result(batch.queries.size());
+    for (size_t i = 0; i < batch.queries.size(); ++i) {
+        result[i] = unique_results[batch.query_to_unique[i]];
+    }
+    return result;
+}
+
+void SearchServer::FindTopDocumentsBatchJoined(const std::vector<std::string>& raw_queries, std::vector<Document>& documents,
+    std::vector<size_t>& offsets, DocumentStatus status, size_t max_document_count) const
+{
+    const QueryBatch batch = SearchServer::PlanQueryBatch(raw_queries);
+    // every query gets a slot as large as its result may be: no more documents than postings of its plus words
+    std::vector<size_t> slot_begins(batch.queries.size() + 1, 0);
+    for (size_t i = 0; i < batch.queries.size(); ++i) {
+        size_t posting_count = 0;
+        for (const TermId term_id : batch.queries[i].plus_terms) {
+            posting_count += postings_[term_id].size();
+        }
+        slot_begins[i + 1] = slot_begins[i] + std::min(posting_count, max_document_count);
+    }
+    documents.resize(slot_begins.back());
+
+    std::vector<size_t> unique_sizes(batch.unique_queries.size());
+    std::for_each(std::execution::par, batch.schedule.begin(), batch.schedule.end(),
+        [&](size_t unique_index) {
+            const size_t query_index = batch.unique_queries[unique_index];
+            const Query& query = batch.queries[query_index];
+            Document* const slot = documents.data() + slot_begins[query_index];
+            unique_sizes[unique_index] = WithQueryContext([&](QueryContext& context) {
+                QueryContext::Lease lease(context);
+                if (!query_cache_) {
+                    CollectTopDocumentsSequential(context, query, StatusIs{ status }, max_document_count);
+                    return context.collector_.ExtractSortedTo(slot);
+                }
+                QueryCacheKey key{ query.plus_terms, query.minus_terms, status, max_document_count };
+                if (auto cached = query_cache_->Find(key, log_sequence_)) {
+                    std::copy(cached->begin(), cached->end(), slot);
+                    return cached->size();
+                }
+                CollectTopDocumentsSequential(context, query, StatusIs{ status }, max_document_count);
+                const size_t size = context.collector_.ExtractSortedTo(slot);
+                query_cache_->Insert(std::move(key), log_sequence_, std::vector<Document>(slot, slot + size));
+                return size;
+            });
+        });
+
+    // slots are packed from the front. A query is never moved past the end of its own slot,
+    // and a repeated query copies the result of its first occurrence, which is already in place
+    offsets.assign(batch.queries.size() + 1, 0);
+    for (size_t i = 0; i < batch.queries.size(); ++i) {
+        const size_t unique_index = batch.query_to_unique[i];
+        const size_t size = unique_sizes[unique_index];
+        const size_t source = batch.unique_queries[unique_index] == i ? slot_begins[i] : offsets[batch.unique_queries[unique_index]];
+        std::copy(documents.begin() + source, documents.begin() + source + size, documents.begin() + offsets[i]);
+        offsets[i + 1] = offsets[i] + size;
+    }
+    documents.resize(offsets.back());
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view& raw_query, int document_id) const {
+    const DocumentOrdinal ordinal = document_to_ordinal_.at(document_id);
     SearchServer::Query query = SearchServer::ParseQuery(std::execution::seq, raw_query);
     std::vector<std::string_view> matched_words;
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_id_freq_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_id_freq_.at(word).count(document_id)) {
-            matched_words.clear();
-            return { {}, documents_.at(document_id).status };
+    for (const TermId term_id : query.minus_terms) {
+        if (postings_[term_id].Contains(ordinal)) {
+            return { std::vector<std::string_view>{}, ordinal_to_status_[ordinal] };
         }
     }
-    for (const std::string_view& word : query.plus_words) {
-        if (word_to_id_freq_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_id_freq_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+    for (const TermId term_id : query.plus_terms) {
+        if (postings_[term_id].Contains(ordinal)) {
+            matched_words.push_back(terms_.GetTerm(term_id));
         }
     }
-    return { matched_words, documents_.at(document_id).status };
+    std::sort(matched_words.begin(), matched_words.end());
+    return { matched_words, ordinal_to_status_[ordinal] };
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy,
@@ -76,43 +262,36 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
         throw std::out_of_range("Document ID does not exist.");
     }
 
+    const DocumentOrdinal ordinal = document_to_ordinal_.at(document_id);
     SearchServer::Query query = SearchServer::ParseQuery(std::execution::par, raw_query);
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    const std::map<std::string_view, double>& document_words = id_to_word_freq_.at(document_id);
-
-    if (!std::none_of(std::execution::par,
-        query.minus_words.begin(),
-        query.minus_words.end(),
-        [&document_words](const std::string_view& minus_word) {
-            return document_words.count(minus_word);
+
+    if (std::any_of(std::execution::par,
+        query.minus_terms.begin(),
+        query.minus_terms.end(),
+        [this, ordinal](TermId term_id) {
+            return postings_[term_id].Contains(ordinal);
         })
         )
     {
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, ordinal_to_status_[ordinal] };
     }
+
+    std::vector<TermId> matched_terms(query.plus_terms.size());
+    matched_terms.erase(
         std::copy_if(std::execution::par,
-            query.plus_words.begin(),
-            query.plus_words.end(),
-            matched_words.begin(),
-            [&document_words](const std::string_view& plus_word) {
-                return document_words.count(plus_word);
-            });
+            query.plus_terms.begin(),
+            query.plus_terms.end(),
+            matched_terms.begin(),
+            [this, ordinal](TermId term_id) {
+                return postings_[term_id].Contains(ordinal);
+            }),
+        matched_terms.end());
 
-        std::sort(std::execution::par,
-            matched_words.begin(),
-            matched_words.end());
-        matched_words.erase(
-            std::unique(std::execution::par,
-                matched_words.begin(), matched_words.end(),
-                [](const std::string_view& lhs, const std::string_view& rhs) {
-                    return lhs == rhs || rhs.empty();
-                }
-            ),
-            matched_words.end());
-        if (!matched_words.empty() && matched_words.front().empty()) {
-            matched_words.erase(matched_words.begin());
-        }
-        return { matched_words, documents_.at(document_id).status };
+    std::vector<std::string_view> matched_words(matched_terms.size());
+    std::transform(matched_terms.begin(), matched_terms.end(), matched_words.begin(),
+        [this](TermId term_id) { return terms_.GetTerm(term_id); });
+    std::sort(std::execution::par, matched_words.begin(), matched_words.end());
+    return { matched_words, ordinal_to_status_[ordinal] };
 }
 
 const std::set<int>::const_iterator SearchServer::begin() const {
@@ -123,31 +302,365 @@ const std::set<int>::const_iterator SearchServer::end() const {
     return documents_ids_.end();
 }
 
+void SearchServer::SetRetrievalMode(RetrievalMode mode) {
+    retrieval_mode_ = mode;
+}
+
+RetrievalMode SearchServer::GetRetrievalMode() const {
+    return retrieval_mode_;
+}
+
+void SearchServer::EnableQueryCache(size_t capacity, size_t shard_count) {
+    query_cache_ = std::make_unique<QueryCache>(capacity, shard_count);
+}
+
+void SearchServer::DisableQueryCache() {
+    query_cache_.reset();
+}
+
+QueryCacheStats SearchServer::GetQueryCacheStats() const {
+    return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
+}
+
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
     static const std::map<std::string_view, double> EMPTY;
-    if (documents_.count(document_id) == 0) {
+    const auto ordinal_iter = document_to_ordinal_.find(document_id);
+    if (ordinal_iter == document_to_ordinal_.end()) {
         return EMPTY;
     }
-    return id_to_word_freq_.at(document_id);
+    const DocumentOrdinal ordinal = ordinal_iter->second;
+    std::lock_guard guard(word_freqs_mutex_);
+    const auto [freqs_iter, inserted] = word_freqs_cache_.try_emplace(document_id);
+    if (inserted) {
+        const TermCount* terms_begin = forward_index_.data() + ordinal_to_forward_begin_[ordinal];
+        for (const TermCount* term = terms_begin; term != terms_begin + ordinal_to_term_count_[ordinal]; ++term) {
+            freqs_iter->second.emplace(terms_.GetTerm(term->term_id), term->count * ordinal_to_inv_word_count_[ordinal]);
+        }
+    }
+    return freqs_iter->second;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
     SearchServer::RemoveDocument(std::execution::seq, document_id);
 }
+
+SearchServer::SearchServer(const std::string& snapshot_path, SnapshotAccess access)
+    : snapshot_(access == SnapshotAccess::MAP_READ_ONLY ? MapSnapshotFile(snapshot_path) : ReadSnapshotFile(snapshot_path))
+    , read_only_(access == SnapshotAccess::MAP_READ_ONLY)
+{
+    // a mapped snapshot is not read as a whole, so its checksum is not verified
+    SnapshotReader reader(snapshot_, !read_only_);
+    terms_ = TermDictionary::Load(reader);
+    postings_ = PostingList::Load(reader);
+    ordinal_to_document_id_ = reader.ReadArray<int>();
+    ordinal_to_rating_ = reader.ReadArray<int>();
+    ordinal_to_status_ = reader.ReadArray<DocumentStatus>();
+    ordinal_to_inv_word_count_ = reader.ReadArray<double>();
+    const MappableVector<uint64_t> text_ends = reader.ReadArray<uint64_t>();
+    const MappableVector<char> texts = reader.ReadArray<char>();
+    ordinal_to_forward_begin_ = reader.ReadArray<uint64_t>();
+    ordinal_to_term_count_ = reader.ReadArray<uint32_t>();
+    forward_index_ = reader.ReadArray<TermCount>();
+    term_document_counts_ = reader.ReadArray<uint32_t>();
+    log_table_ = reader.ReadArray<double>();
+    log_sequence_ = reader.ReadValue<uint64_t>();
+
+    const size_t ordinal_count = ordinal_to_document_id_.size();
+    if (postings_.size() != terms_.size()
+        || term_document_counts_.size() != terms_.size()
+        || ordinal_to_rating_.size() != ordinal_count
+        || ordinal_to_status_.size() != ordinal_count
+        || ordinal_to_inv_word_count_.size() != ordinal_count
+        || text_ends.size() != ordinal_count
+        || ordinal_to_forward_begin_.size() != ordinal_count
+        || ordinal_to_term_count_.size() != ordinal_count
+        || log_table_.size() <= ordinal_count)
+    {
+        throw std::runtime_error("Snapshot is corrupted: index parts do not match");
+    }
+    // a mapped snapshot is not checksummed, so nothing it holds may index past the arrays
+    for (const PostingList& postings : postings_) {
+        if (!postings.HasOrdinalsBelow(ordinal_count)) {
+            throw std::runtime_error("Snapshot is corrupted: posting is out of range");
+        }
+    }
+    for (const uint32_t document_count : term_document_counts_) {
+        if (document_count > ordinal_count) {
+            throw std::runtime_error("Snapshot is corrupted: term is out of range");
+        }
+    }
+    for (const TermCount& term : forward_index_) {
+        if (term.term_id >= terms_.size()) {
+            throw std::runtime_error("Snapshot is corrupted: term is out of range");
+        }
+    }
+
+    // only what cannot be used in place is built here: id lookups, status bitmaps and text views
+    ordinal_to_text_.reserve(ordinal_count);
+    uint64_t text_begin = 0;
+    for (DocumentOrdinal ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        if (text_ends[ordinal] < text_begin || text_ends[ordinal] > texts.size()
+            || ordinal_to_forward_begin_[ordinal] + ordinal_to_term_count_[ordinal] > forward_index_.size())
+        {
+            throw std::runtime_error("Snapshot is corrupted: document is out of range");
+        }
+        ordinal_to_text_.emplace_back(texts.data() + text_begin, static_cast<size_t>(text_ends[ordinal] - text_begin));
+        text_bytes_ += ordinal_to_text_.back().size();
+        text_begin = text_ends[ordinal];
+
+        const int document_id = ordinal_to_document_id_[ordinal];
+        if (document_id == -1) {
+            ++removed_ordinal_count_;
+            continue;
+        }
+        document_to_ordinal_.emplace(document_id, ordinal);
+        documents_ids_.insert(document_id);
+        status_to_documents_[ordinal_to_status_[ordinal]].Add(ordinal);
+        rating_to_documents_[ordinal_to_rating_[ordinal]].Add(ordinal);
+    }
+}
+
+void SearchServer::SaveSnapshot(const std::string& snapshot_path) const {
+    SnapshotWriter writer(snapshot_path);
+    terms_.Save(writer);
+    PostingList::Save(postings_, writer);
+    writer.WriteArray(ordinal_to_document_id_);
+    writer.WriteArray(ordinal_to_rating_);
+    writer.WriteArray(ordinal_to_status_);
+    writer.WriteArray(ordinal_to_inv_word_count_);
+
+    // texts and forward index slices are written without the removed ones
+    std::vector<uint64_t> text_ends;
+    text_ends.reserve(ordinal_to_text_.size());
+    uint64_t text_end = 0;
+    for (const std::string_view text : ordinal_to_text_) {
+        text_end += text.size();
+        text_ends.push_back(text_end);
+    }
+    writer.WriteArray(text_ends);
+    writer.BeginArray<char>(text_end);
+    for (const std::string_view text : ordinal_to_text_) {
+        writer.WriteElements(text.data(), text.size());
+    }
+    writer.EndArray();
+
+    std::vector<uint64_t> forward_begins;
+    forward_begins.reserve(ordinal_to_term_count_.size());
+    uint64_t forward_end = 0;
+    for (const uint32_t term_count : ordinal_to_term_count_) {
+        forward_begins.push_back(forward_end);
+        forward_end += term_count;
+    }
+    writer.WriteArray(forward_begins);
+    writer.WriteArray(ordinal_to_term_count_);
+    writer.BeginArray<TermCount>(forward_end);
+    for (DocumentOrdinal ordinal = 0; ordinal < ordinal_to_term_count_.size(); ++ordinal) {
+        writer.WriteElements(forward_index_.data() + ordinal_to_forward_begin_[ordinal], ordinal_to_term_count_[ordinal]);
+    }
+    writer.EndArray();
+
+    writer.WriteArray(term_document_counts_);
+    writer.WriteArray(log_table_);
+    writer.WriteValue(log_sequence_);
+    writer.Finish();
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    ThrowIfReadOnly();
+    for (const int document_id : document_ids) {
+        SearchServer::MarkDocumentRemoved(std::execution::seq, document_id);
+    }
+    SearchServer::CompactIfNeeded();
+}
+
+void SearchServer::Compact() {
+    ThrowIfReadOnly();
+    if (removed_ordinal_count_ == 0) {
+        return;
+    }
+    std::vector<DocumentOrdinal> live_ordinals;
+    live_ordinals.reserve(ordinal_to_document_id_.size() - removed_ordinal_count_);
+    std::vector<DocumentOrdinal> new_ordinals(ordinal_to_document_id_.size());
+    for (DocumentOrdinal ordinal = 0; ordinal < ordinal_to_document_id_.size(); ++ordinal) {
+        if (ordinal_to_document_id_[ordinal] != -1) {
+            new_ordinals[ordinal] = static_cast<DocumentOrdinal>(live_ordinals.size());
+            live_ordinals.push_back(ordinal);
+        }
+    }
+
+    // renumbering keeps the order, so every list is merged into a new one by appending live postings
+    std::vector<TermId> term_ids(postings_.size());
+    std::iota(term_ids.begin(), term_ids.end(), 0);
+    std::for_each(std::execution::par, term_ids.begin(), term_ids.end(),
+        [this, &new_ordinals](TermId term_id) {
+            if (postings_[term_id].empty()) {
+                return;
+            }
+            PostingList merged;
+            postings_[term_id].ForEach([&](DocumentOrdinal ordinal, uint32_t count) {
+                if (ordinal_to_document_id_[ordinal] != -1) {
+                    merged.Insert(new_ordinals[ordinal], count, count * ordinal_to_inv_word_count_[ordinal]);
+                }
+            });
+            postings_[term_id] = std::move(merged);
+        });
+
+    const auto compact_column = [&live_ordinals](auto& column) {
+        std::vector<std::decay_t<decltype(column[0])>> compacted;
+        compacted.reserve(live_ordinals.size());
+        for (const DocumentOrdinal ordinal : live_ordinals) {
+            compacted.push_back(column[ordinal]);
+        }
+        return compacted;
+    };
+    ordinal_to_rating_ = MappableVector<int>(compact_column(ordinal_to_rating_));
+    ordinal_to_status_ = MappableVector<DocumentStatus>(compact_column(ordinal_to_status_));
+    ordinal_to_inv_word_count_ = MappableVector<double>(compact_column(ordinal_to_inv_word_count_));
+    ordinal_to_forward_begin_ = MappableVector<uint64_t>(compact_column(ordinal_to_forward_begin_));
+    ordinal_to_term_count_ = MappableVector<uint32_t>(compact_column(ordinal_to_term_count_));
+    ordinal_to_text_ = compact_column(ordinal_to_text_);
+    ordinal_to_document_id_ = MappableVector<int>(compact_column(ordinal_to_document_id_));
+
+    status_to_documents_.clear();
+    rating_to_documents_.clear();
+    for (DocumentOrdinal ordinal = 0; ordinal < ordinal_to_document_id_.size(); ++ordinal) {
+        document_to_ordinal_[ordinal_to_document_id_[ordinal]] = ordinal;
+        status_to_documents_[ordinal_to_status_[ordinal]].Add(ordinal);
+        rating_to_documents_[ordinal_to_rating_[ordinal]].Add(ordinal);
+    }
+    removed_ordinal_count_ = 0;
+}
+
+void SearchServer::OpenWriteAheadLog(const std::string& log_path, const WriteAheadLogOptions& options) {
+    ThrowIfReadOnly();
+    // replayed changes must not be logged again
+    log_.reset();
+    log_ = std::make_unique<WriteAheadLog>(log_path, options, [this](const LogRecord& record) {
+        if (record.sequence <= log_sequence_) {
+            return;
+        }
+        if (record.type == LogRecordType::ADD_DOCUMENT) {
+            SearchServer::AddDocument(record.document_id, record.text, record.status, record.ratings);
+        }
+        else {
+            SearchServer::RemoveDocument(record.document_id);
+        }
+        log_sequence_ = record.sequence;
+    });
+}
+
+void SearchServer::CommitWriteAheadLog() {
+    if (log_) {
+        log_->Commit();
+    }
+}
+
+void SearchServer::Checkpoint(const std::string& snapshot_path) {
+    SearchServer::CommitWriteAheadLog();
+    // the old snapshot is replaced only by a complete new one
+    const std::string temp_path = snapshot_path + ".tmp";
+    SearchServer::SaveSnapshot(temp_path);
+    // the log is dropped only once the new snapshot opens as this index and it and its name are on disk
+    SyncSnapshotFile(temp_path);
+    {
+        const SearchServer written(temp_path, SnapshotAccess::LOAD);
+        if (written.GetDocumentCount() != SearchServer::GetDocumentCount() || written.log_sequence_ != log_sequence_) {
+            throw std::runtime_error("Checkpoint snapshot does not match the index");
+        }
+    }
+    std::filesystem::rename(temp_path, snapshot_path);
+    SyncSnapshotDirectory(snapshot_path);
+    if (log_) {
+        log_->Truncate();
+    }
+}
 // ===================== Private ===================== 
 
-bool SearchServer::IsStopWord(const std::string_view& word) const {
-    return stop_words_.count(std::string(word)) > 0;
+void SearchServer::CheckNewDocumentId(int document_id) const {
+    if (document_id < 0) {
+        throw std::invalid_argument("Document's ID must not be negative");
+    }
+    if (document_to_ordinal_.count(document_id)) {
+        throw std::invalid_argument("Document's ID must not already exist");
+    }
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
-    std::vector<std::string_view> words;
-    for (const std::string_view& word : SplitIntoWordsView(text)) {
-        if (!SearchServer::IsStopWord(word)) {
-            words.push_back(word);
+DocumentOrdinal SearchServer::StoreDocument(int document_id, std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings, const std::vector<TermCount>& term_counts, uint32_t word_count)
+{
+    const DocumentOrdinal ordinal = static_cast<DocumentOrdinal>(ordinal_to_document_id_.size());
+    ordinal_to_document_id_.Mutable().push_back(document_id);
+    ordinal_to_rating_.Mutable().push_back(SearchServer::ComputeAverageRating(ratings));
+    ordinal_to_status_.Mutable().push_back(status);
+    ordinal_to_inv_word_count_.Mutable().push_back(1.0 / word_count);
+    ordinal_to_text_.push_back(document_texts_.Append(document));
+    text_bytes_ += document.size();
+    status_to_documents_[status].Add(ordinal);
+    rating_to_documents_[ordinal_to_rating_[ordinal]].Add(ordinal);
+    document_to_ordinal_.emplace(document_id, ordinal);
+    documents_ids_.insert(document_id);
+
+    std::vector<double>& log_table = log_table_.Mutable();
+    while (log_table.size() <= ordinal_to_document_id_.size()) {
+        log_table.push_back(log(static_cast<double>(log_table.size())));
+    }
+
+    postings_.resize(terms_.size());
+    std::vector<uint32_t>& term_document_counts = term_document_counts_.Mutable();
+    term_document_counts.resize(terms_.size());
+    std::vector<TermCount>& forward_index = forward_index_.Mutable();
+    ordinal_to_forward_begin_.Mutable().push_back(forward_index.size());
+    ordinal_to_term_count_.Mutable().push_back(static_cast<uint32_t>(term_counts.size()));
+    for (const TermCount& term : term_counts) {
+        ++term_document_counts[term.term_id];
+        forward_index.push_back(term);
+    }
+    return ordinal;
+}
+
+void SearchServer::CompactIfNeeded() {
+    if (4 * removed_ordinal_count_ > ordinal_to_document_id_.size()) {
+        SearchServer::Compact();
+    }
+}
+
+void SearchServer::ThrowIfReadOnly() const {
+    if (read_only_) {
+        throw std::logic_error("Search server opened from a mapped snapshot is read-only");
+    }
+}
+
+void SearchServer::ReleaseDocumentText(DocumentOrdinal ordinal) {
+    text_bytes_ -= ordinal_to_text_[ordinal].size();
+    removed_text_bytes_ += ordinal_to_text_[ordinal].size();
+    ordinal_to_text_[ordinal] = {};
+    // texts are copied to a fresh arena once removed ones take more space than the rest
+    if (removed_text_bytes_ > text_bytes_) {
+        TextArena compacted;
+        for (std::string_view& text : ordinal_to_text_) {
+            text = compacted.Append(text);
+        }
+        document_texts_ = std::move(compacted);
+        removed_text_bytes_ = 0;
+    }
+}
+
+void SearchServer::ReleaseDocumentTerms(DocumentOrdinal ordinal) {
+    removed_forward_entries_ += ordinal_to_term_count_[ordinal];
+    ordinal_to_term_count_.Mutable()[ordinal] = 0;
+    // the same rule as for texts: slices are moved together once removed ones are the majority
+    if (2 * removed_forward_entries_ > forward_index_.size()) {
+        std::vector<TermCount> compacted;
+        compacted.reserve(forward_index_.size() - removed_forward_entries_);
+        std::vector<uint64_t>& forward_begins = ordinal_to_forward_begin_.Mutable();
+        for (size_t i = 0; i < forward_begins.size(); ++i) {
+            const TermCount* terms_begin = forward_index_.data() + forward_begins[i];
+            forward_begins[i] = compacted.size();
+            compacted.insert(compacted.end(), terms_begin, terms_begin + ordinal_to_term_count_[i]);
         }
+        forward_index_.Mutable() = std::move(compacted);
+        removed_forward_entries_ = 0;
     }
-    return words;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -159,62 +672,223 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
 
 SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
     bool is_minus = false;
-    if (text[0] == '-') {
+    if (!text.empty() && text[0] == '-') {
         is_minus = true;
         text = text.substr(1);
     }
-    if (SearchServer::IsValidWord(text) && !text.empty() && text[0] != '-') {
-        return SearchServer::QueryWord{ text, is_minus, SearchServer::IsStopWord(text) };
+    if (!text.empty() && text[0] != '-') {
+        return SearchServer::QueryWord{ text, is_minus };
     }
     else {
         throw std::invalid_argument("Invalid word or control character in ParseQueryWord()");
     }
 }
 
+SearchServer::QueryBatch SearchServer::PlanQueryBatch(const std::vector<std::string>& raw_queries) const {
+    QueryBatch batch;
+    std::vector<Query>& queries = batch.queries;
+    queries.resize(raw_queries.size());
+    std::transform(std::execution::par, raw_queries.begin(), raw_queries.end(), queries.begin(),
+        [this](const std::string& raw_query) { return ParseQuery(std::execution::seq, raw_query); });
+
+    // equal queries become neighbours, only the first one of a run is computed
+    std::vector<size_t> order(queries.size());
+    std::iota(order.begin(), order.end(), 0);
+    const auto query_less = [&queries](size_t lhs, size_t rhs) {
+        return std::tie(queries[lhs].plus_terms, queries[lhs].minus_terms)
+            < std::tie(queries[rhs].plus_terms, queries[rhs].minus_terms);
+    };
+    std::stable_sort(order.begin(), order.end(), query_less);
+    batch.query_to_unique.resize(queries.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i == 0 || query_less(order[i - 1], order[i])) {
+            batch.unique_queries.push_back(order[i]);
+        }
+        batch.query_to_unique[order[i]] = batch.unique_queries.size() - 1;
+    }
+
+    // a query costs about as much as the postings it may read. The costliest ones are started first,
+    // so the cheap ones fill the gaps at the end instead of one long query finishing last
+    std::vector<size_t> costs(batch.unique_queries.size());
+    std::transform(batch.unique_queries.begin(), batch.unique_queries.end(), costs.begin(),
+        [this, &queries](size_t query_index) {
+            size_t cost = 0;
+            for (const TermId term_id : queries[query_index].plus_terms) {
+                cost += postings_[term_id].size();
+            }
+            for (const TermId term_id : queries[query_index].minus_terms) {
+                cost += postings_[term_id].size();
+            }
+            return cost;
+        });
+    batch.schedule.resize(batch.unique_queries.size());
+    std::iota(batch.schedule.begin(), batch.schedule.end(), 0);
+    std::stable_sort(batch.schedule.begin(), batch.schedule.end(),
+        [&costs](size_t lhs, size_t rhs) { return costs[lhs] > costs[rhs]; });
+    return batch;
+}
 
 SearchServer::Query SearchServer::ParseQuery(std::execution::parallel_policy, const std::string_view& text) const {
     return SearchServer::ParseQuery(std::execution::seq, text);
-
-    // do not use! it works wrong !!!
-    //SearchServer::Query query;
-    //if (text.empty()) {
-    //    return query;
-    //}
-    //for (const std::string_view& word : SplitIntoWordsView(text)) {
-    //    SearchServer::QueryWord query_word = SearchServer::ParseQueryWord(word);
-    //    if (!query_word.is_stop && !query_word.data.empty()) {
-    //        query_word.is_minus
-    //            ? query.minus_words.push_back(query_word.data)
-    //            : query.plus_words.push_back(query_word.data);
-    //    }
-    //}
-    //return query;
 }
 
 SearchServer::Query SearchServer::ParseQuery(std::execution::sequenced_policy, const std::string_view& text) const {
     SearchServer::Query query;
+    std::vector<std::string_view> words;
+    SearchServer::ParseQuery(text, words, query);
+    return query;
+}
+
+void SearchServer::ParseQuery(const std::string_view& text, std::vector<std::string_view>& words, Query& query) const {
+    query.plus_terms.clear();
+    query.minus_terms.clear();
     if (text.empty()) {
-        return query;
+        return;
     }
-    for (const std::string_view& word : SplitIntoWordsView(text)) {
+    // control characters are found while splitting, so words are not scanned again
+    if (!SplitIntoWordsView(text, words)) {
+        throw std::invalid_argument("Invalid word or control character in ParseQueryWord()");
+    }
+    for (const std::string_view& word : words) {
         SearchServer::QueryWord query_word = SearchServer::ParseQueryWord(word);
-        if (!query_word.is_stop && !query_word.data.empty()) {
-            query_word.is_minus
-                ? query.minus_words.push_back(query_word.data)
-                : query.plus_words.push_back(query_word.data);
-        }
-    }
-    std::sort(query.plus_words.begin(), query.plus_words.end());
-    std::sort(query.minus_words.begin(), query.minus_words.end());
-    query.plus_words.erase(
-        std::unique(query.plus_words.begin(), query.plus_words.end()),
-        query.plus_words.end());
-    query.minus_words.erase(
-        std::unique(query.minus_words.begin(), query.minus_words.end()),
-        query.minus_words.end());
-    return query;
+        if (query_word.data.empty()) {
+            continue;
+        }
+        // stop words are dropped here as well, they never have postings
+        const std::optional<TermId> term_id = terms_.Find(query_word.data);
+        if (!term_id || term_document_counts_[*term_id] == 0) {
+            continue;
+        }
+        query_word.is_minus
+            ? query.minus_terms.push_back(*term_id)
+            : query.plus_terms.push_back(*term_id);
+    }
+    std::sort(query.plus_terms.begin(), query.plus_terms.end());
+    std::sort(query.minus_terms.begin(), query.minus_terms.end());
+    query.plus_terms.erase(
+        std::unique(query.plus_terms.begin(), query.plus_terms.end()),
+        query.plus_terms.end());
+    query.minus_terms.erase(
+        std::unique(query.minus_terms.begin(), query.minus_terms.end()),
+        query.minus_terms.end());
+}
+
+SearchServer::OrdinalFilter::OrdinalFilter(const SearchServer& server)
+    : server_(server) {
+}
+
+void SearchServer::OrdinalFilter::Require(const StatusIs& status_is) {
+    if (has_status_) {
+        is_empty_ = is_empty_ || status_is.status != status_;
+        return;
+    }
+    has_status_ = true;
+    status_ = status_is.status;
+    const auto documents_iter = server_.status_to_documents_.find(status_);
+    if (documents_iter == server_.status_to_documents_.end()) {
+        is_empty_ = true;
+        return;
+    }
+    status_documents_ = &documents_iter->second;
+}
+
+void SearchServer::OrdinalFilter::Require(const RatingAtLeast& rating_at_least) {
+    min_rating_ = std::max(min_rating_, rating_at_least.min_rating);
+    rating_documents_begin_ = server_.rating_to_documents_.lower_bound(min_rating_);
+    const auto rating_documents_end = server_.rating_to_documents_.end();
+    if (std::all_of(rating_documents_begin_, rating_documents_end,
+        [](const auto& rating_documents) { return rating_documents.second.size() == 0; }))
+    {
+        is_empty_ = true;
+    }
+    has_rating_documents_ = static_cast<size_t>(std::distance(rating_documents_begin_, rating_documents_end)) <= MAX_PROBED_RATINGS;
+}
+
+void SearchServer::OrdinalFilter::Require(const IdIn& id_in) {
+    // several sets of ids leave the ordinals that are in all of them
+    DocumentBitmap id_documents;
+    for (const int document_id : id_in.GetIds()) {
+        const auto ordinal_iter = server_.document_to_ordinal_.find(document_id);
+        if (ordinal_iter != server_.document_to_ordinal_.end()
+            && (!has_ids_ || id_documents_.Contains(ordinal_iter->second)))
+        {
+            id_documents.Add(ordinal_iter->second);
+        }
+    }
+    has_ids_ = true;
+    id_documents_ = std::move(id_documents);
+    is_empty_ = is_empty_ || id_documents_.size() == 0;
+}
+
+void SearchServer::OrdinalFilter::Require(const AnyDocument&) {
+}
+
+bool SearchServer::OrdinalFilter::IsEmpty() const {
+    return is_empty_;
+}
+
+bool SearchServer::OrdinalFilter::MayIntersect(DocumentOrdinal first, DocumentOrdinal last) const {
+    return (status_documents_ == nullptr || status_documents_->Intersects(first, last))
+        && (!has_ids_ || id_documents_.Intersects(first, last))
+        && (!has_rating_documents_ || std::any_of(rating_documents_begin_, server_.rating_to_documents_.cend(),
+            [first, last](const auto& rating_documents) { return rating_documents.second.Intersects(first, last); }));
+}
+
+bool SearchServer::OrdinalFilter::Accepts(DocumentOrdinal ordinal) const {
+    // both bitmaps hold only documents that are not removed
+    if (status_documents_ == nullptr && !has_ids_ && server_.ordinal_to_document_id_[ordinal] == -1) {
+        return false;
+    }
+    return (status_documents_ == nullptr || status_documents_->Contains(ordinal))
+        && (!has_ids_ || id_documents_.Contains(ordinal))
+        && server_.ordinal_to_rating_[ordinal] >= min_rating_;
+}
+
+size_t SearchServer::OrdinalFilter::Apply(DocumentOrdinal* ordinals, uint32_t* counts, size_t size) const {
+    if (status_documents_ != nullptr) {
+        size = status_documents_->Filter(ordinals, counts, size);
+    }
+    if (has_ids_) {
+        size = id_documents_.Filter(ordinals, counts, size);
+    }
+    // the loops below write every posting and move on only if it passes, there is no branch to mispredict
+    if (status_documents_ == nullptr && !has_ids_) {
+        const int* document_ids = server_.ordinal_to_document_id_.data();
+        size_t kept = 0;
+        for (size_t i = 0; i < size; ++i) {
+            ordinals[kept] = ordinals[i];
+            counts[kept] = counts[i];
+            kept += document_ids[ordinals[i]] != -1;
+        }
+        size = kept;
+    }
+    if (min_rating_ != std::numeric_limits<int>::min()) {
+        const int* ratings = server_.ordinal_to_rating_.data();
+        size_t kept = 0;
+        for (size_t i = 0; i < size; ++i) {
+            ordinals[kept] = ordinals[i];
+            counts[kept] = counts[i];
+            kept += ratings[ordinals[i]] >= min_rating_;
+        }
+        size = kept;
+    }
+    return size;
+}
+
+SearchServer::QueryContext& SearchServer::GetThreadQueryContext() {
+    thread_local QueryContext context;
+    return context;
+}
+
+void SearchServer::QueryContext::ReleaseLargeBuffers() {
+    if (scores_.GetSlotCount() > MAX_RETAINED_ORDINALS) {
+        scores_.Release();
+    }
+    if (touched_.capacity() > MAX_RETAINED_ORDINALS) {
+        std::vector<DocumentOrdinal>().swap(touched_);
+    }
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view& word) const {
-    return log(SearchServer::GetDocumentCount() * 1.0 / word_to_id_freq_.at(word).size());
+double SearchServer::ComputeWordInverseDocumentFreq(size_t document_freq) const {
+    return log_table_[SearchServer::GetDocumentCount()] - log_table_[document_freq];
 }
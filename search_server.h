@@ -1,34 +1,67 @@
 #pragma once
 #include <algorithm>
 #include <cmath>
+#include <exception>
 #include <execution>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <vector>
-#include "concurrent_map.h"
 #include "document.h"
+#include "document_bitmap.h"
+#include "document_filters.h"
 #include "log_duration.h"
+#include "mappable_vector.h"
+#include "posting_list.h"
+#include "query_cache.h"
 #include "read_input_functions.h"
+#include "score_accumulator.h"
+#include "snapshot_io.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
+#include "text_arena.h"
+#include "top_documents_collector.h"
+#include "write_ahead_log.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double EPSILON = 1e-6;
+
+enum class RetrievalMode {
+    // every posting of every plus-word is scored
+    EXHAUSTIVE,
+    // document-at-a-time MaxScore with block-max bounds, skips documents that cannot enter the top.
+    // Used by the sequential policy, gives exactly the same result as EXHAUSTIVE
+    MAX_SCORE,
+};
+
+// how a server opens a snapshot file
+enum class SnapshotAccess {
+    // the file is read into memory with one bulk read, the server can be changed afterwards
+    LOAD,
+    // the file is mapped into memory and searched in place, pages are shared by all processes
+    // that map it. The checksum is not verified and the server cannot be changed
+    MAP_READ_ONLY,
+};
 
 class SearchServer {
 public:
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words)
-        : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
-        for (const std::string& word : stop_words) {
+    explicit SearchServer(const StringContainer& stop_words) {
+        for (const std::string& word : MakeUniqueNonEmptyStrings(stop_words)) {
             if (!IsValidWord(word)) {
                 throw std::invalid_argument("Stop words must not contain control characters");
             }
+            terms_.AddStopWord(word);
         }
+        postings_.resize(terms_.size());
+        term_document_counts_.Mutable().resize(terms_.size());
     }
 
     explicit SearchServer(const std::string_view stop_words_text)
@@ -39,18 +72,35 @@ public:
         : SearchServer(SplitIntoWords(stop_words_text)) {
     }
 
+    // opens a snapshot written by SaveSnapshot, documents are not tokenized again
+    SearchServer(const std::string& snapshot_path, SnapshotAccess access);
+    // writes the complete state: stop words, dictionary, postings, forward index, attributes and texts
+    void SaveSnapshot(const std::string& snapshot_path) const;
+
+    // changes found in the log are applied over the current state, usually a loaded checkpoint,
+    // then every AddDocument and RemoveDocument is logged before it is applied
+    void OpenWriteAheadLog(const std::string& log_path, const WriteAheadLogOptions& options = {});
+    // writes records buffered by group commit
+    void CommitWriteAheadLog();
+    // replaces the snapshot with the current state and empties the log. The snapshot is synced to disk first
+    void Checkpoint(const std::string& snapshot_path);
+
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status,
         const std::vector<int>& ratings);
+    // adds the whole batch or, if some document is rejected for the same reasons as in AddDocument,
+    // nothing at all. Documents are tokenized in parallel and postings are merged term by term
+    void AddDocuments(const std::vector<NewDocument>& documents);
     static bool IsValidWord(const std::string_view& word);
     int GetDocumentCount() const;
 
+    // max_document_count limits the size of the result, documents beyond it are never sorted
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentPredicate document_predicate,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentStatus status) const {
-        return SearchServer::FindTopDocuments(policy, raw_query,
-            [status](int document_id, DocumentStatus document_status, int rating)
-            { return document_status == status; });
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query, DocumentStatus status,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return SearchServer::FindTopDocuments(policy, raw_query, StatusIs{ status }, max_document_count);
     }
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query) const {
@@ -58,16 +108,54 @@ public:
     }
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const {
-        return SearchServer::FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return SearchServer::FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_document_count);
     }
-    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const {
-        return SearchServer::FindTopDocuments(std::execution::seq, raw_query, status);
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return SearchServer::FindTopDocuments(std::execution::seq, raw_query, status, max_document_count);
     }
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const {
         return SearchServer::FindTopDocuments(std::execution::seq, raw_query);
     }
 
+    // scratch buffers of queries, see the definition below
+    class QueryContext;
+
+    // overloads above take buffers of the calling thread, these ones use buffers kept by the caller
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(QueryContext& context, const std::string_view& raw_query, DocumentPredicate document_predicate,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return SearchServer::FindTopDocumentsInContext(std::execution::seq, context, raw_query, document_predicate, max_document_count);
+    }
+    std::vector<Document> FindTopDocuments(QueryContext& context, const std::string_view& raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return SearchServer::FindTopDocuments(context, raw_query, StatusIs{ status }, max_document_count);
+    }
+
+    // documents sorted by rating from the highest one, documents of equal rating by relevance.
+    // The highest ratings are searched one at a time and the search stops once max_document_count documents
+    // are found. That pays off only if they are found among the eight highest ratings:
+    // past them the lower ratings are searched in one pass and sorted, like a full search
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByRating(const std::string_view& raw_query, DocumentPredicate document_predicate,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocumentsByRating(const std::string_view& raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const {
+        return SearchServer::FindTopDocumentsByRating(raw_query, StatusIs{ status }, max_document_count);
+    }
+
+    // answers every query like FindTopDocuments with the status. Queries that parse to the same terms
+    // are computed once, the rest are spread over threads starting from the longest posting lists
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // the same in one array: documents found for query i take [offsets[i], offsets[i + 1]).
+    // Every query writes its documents straight into the array
+    void FindTopDocumentsBatchJoined(const std::vector<std::string>& raw_queries, std::vector<Document>& documents,
+        std::vector<size_t>& offsets, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t max_document_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query,
         int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy,
@@ -78,162 +166,804 @@ public:
     const std::set<int>::const_iterator begin() const;
     const std::set<int>::const_iterator end() const;
 
+    void SetRetrievalMode(RetrievalMode mode);
+    RetrievalMode GetRetrievalMode() const;
+
+    // results of queries with a status filter are kept for up to capacity queries, zero keeps none.
+    // Any AddDocument or RemoveDocument makes them stale, custom predicates never use the cache
+    void EnableQueryCache(size_t capacity, size_t shard_count = QueryCache::DEFAULT_SHARD_COUNT);
+    void DisableQueryCache();
+    QueryCacheStats GetQueryCacheStats() const;
+
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // calls func(term_id) for every word of the document in ascending order of term ids, nothing for unknown ids
+    template <typename Func>
+    void ForEachDocumentTerm(int document_id, Func func) const;
     void RemoveDocument(int document_id);
+    // documents are only marked removed, postings are merged away by a single Compact at the end
+    // if removed documents then take a quarter of the ordinals. Unknown ids are skipped
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    // drops postings of removed documents and renumbers the rest densely.
+    // Runs by itself once removed documents take a quarter of the ordinals
+    void Compact();
 
     // no check for ExecutionPolicy input class!!!
     template <class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& exe_policy, int document_id) {
-        if (documents_.count(document_id) == 0) {
-            return;
+        ThrowIfReadOnly();
+        if (MarkDocumentRemoved(exe_policy, document_id)) {
+            CompactIfNeeded();
         }
-        std::vector<const std::string_view*> ptr_words_to_remove;
-        ptr_words_to_remove.reserve(id_to_word_freq_.at(document_id).size());
-
-        std::transform(
-            exe_policy,
-            id_to_word_freq_[document_id].begin(),
-            id_to_word_freq_[document_id].end(),
-            ptr_words_to_remove.begin(),
-            [](std::pair<const std::string_view, double>& element) {
-                return &element.first;
-            }
-        );
-
-        std::for_each(
-            exe_policy,
-            ptr_words_to_remove.begin(),
-            ptr_words_to_remove.end(),
-            [this, document_id](const std::string_view* word) {
-                word_to_id_freq_[*word].erase(document_id);
-                return;
-            }
-        );
-
-        id_to_word_freq_.erase(document_id);
-        documents_ids_.erase(std::find(exe_policy, documents_ids_.begin(), documents_ids_.end(), document_id));
-        documents_.erase(document_id);
     }
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string text;
+    // inverted index: term dictionary and contiguous posting lists indexed by term id.
+    // Stop words are in the dictionary as well, their posting lists stay empty.
+    // Lists only grow at the end: removed documents stay in them as tombstones, so a sealed block
+    // is never rewritten until Compact merges them away
+    TermDictionary terms_;
+    std::vector<PostingList> postings_;
+    // number of live documents with the term, lists may be longer
+    MappableVector<uint32_t> term_document_counts_;
+
+    // forward index: terms of every document sorted by term id, a slice of forward_index_.
+    // Slices of removed documents stay there until the index is compacted
+    struct TermCount {
+        TermId term_id;
+        uint32_t count;
     };
+    MappableVector<TermCount> forward_index_;
+    MappableVector<uint64_t> ordinal_to_forward_begin_;
+    MappableVector<uint32_t> ordinal_to_term_count_;
+    size_t removed_forward_entries_ = 0;
+    // GetWordFrequencies hands out references, so its maps are built on the first request
+    // and live until the document is removed. Word views in the keys point into terms_
+    mutable std::map<int, std::map<std::string_view, double>> word_freqs_cache_;
+    mutable std::mutex word_freqs_mutex_;
+
+    // every document gets the next ordinal, ordinals of removed documents are dropped by Compact
+    std::map<int, DocumentOrdinal> document_to_ordinal_;
+    size_t removed_ordinal_count_ = 0;
 
-    const std::set<std::string> stop_words_;
+    // document attributes are stored column by column and indexed by ordinal,
+    // -1 in ordinal_to_document_id_ marks a removed document
+    MappableVector<int> ordinal_to_document_id_;
+    MappableVector<int> ordinal_to_rating_;
+    MappableVector<DocumentStatus> ordinal_to_status_;
+    // postings keep word counts, term frequency is count * inverse word count of the document
+    MappableVector<double> ordinal_to_inv_word_count_;
+    // views into document_texts_ or into the snapshot, removed texts stay in the arena until it is compacted
+    std::vector<std::string_view> ordinal_to_text_;
+    TextArena document_texts_;
+    size_t text_bytes_ = 0;
+    size_t removed_text_bytes_ = 0;
+    // ordinals of documents with each status, searches by status filter postings with them
+    std::map<DocumentStatus, DocumentBitmap> status_to_documents_;
+    // the same by average rating, rating filters skip blocks with them and search by rating walks them from the top
+    std::map<int, DocumentBitmap> rating_to_documents_;
 
-    std::map<std::string_view, std::map<int, double>> word_to_id_freq_;
-    std::map<int, std::map<std::string_view, double>> id_to_word_freq_;
+    RetrievalMode retrieval_mode_ = RetrievalMode::EXHAUSTIVE;
+
+    // log_table_[n] == log(n) for every n up to the number of ordinals,
+    // so inverse document frequency costs two loads instead of a log per query word
+    MappableVector<double> log_table_;
 
     std::set<int> documents_ids_;
-    std::map<int, DocumentData> documents_;
+    // words of the document being added
+    std::vector<std::string_view> word_buffer_;
+
+    // bytes of the snapshot the server was opened from, loaded structures refer to them
+    std::shared_ptr<const SnapshotBuffer> snapshot_;
+    bool read_only_ = false;
+
+    // sequence number of the last change, snapshots keep it so that replay skips older records
+    uint64_t log_sequence_ = 0;
+    std::unique_ptr<WriteAheadLog> log_;
+    // entries are tagged with log_sequence_, which every change moves forward
+    std::unique_ptr<QueryCache> query_cache_;
 
 private:
-    bool IsStopWord(const std::string_view& word) const;
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text) const;
+    // a filter from document_filters.h turned into checks of ordinals for one query:
+    // bitmaps of the status and of the ids, then the rating column
+    class OrdinalFilter {
+    public:
+        explicit OrdinalFilter(const SearchServer& server);
+
+        void Require(const StatusIs& status_is);
+        void Require(const RatingAtLeast& rating_at_least);
+        void Require(const IdIn& id_in);
+        void Require(const AnyDocument& any_document);
+        template <typename... Filters>
+        void Require(const AllOf<Filters...>& all_of) {
+            std::apply([this](const Filters&... filters) { (Require(filters), ...); }, all_of.GetFilters());
+        }
+
+        // no document can pass
+        bool IsEmpty() const;
+        // false if no ordinal from [first, last] can pass, such blocks are not even decoded
+        bool MayIntersect(DocumentOrdinal first, DocumentOrdinal last) const;
+        bool Accepts(DocumentOrdinal ordinal) const;
+        // keeps postings that pass at the front of the arrays and returns their number
+        size_t Apply(DocumentOrdinal* ordinals, uint32_t* counts, size_t size) const;
+
+    private:
+        const SearchServer& server_;
+        bool has_status_ = false;
+        DocumentStatus status_ = DocumentStatus::ACTUAL;
+        const DocumentBitmap* status_documents_ = nullptr;
+        bool has_ids_ = false;
+        DocumentBitmap id_documents_;
+        int min_rating_ = std::numeric_limits<int>::min();
+        // bitmaps of ratings from min_rating_ up, blocks are checked against them only if there are a few
+        bool has_rating_documents_ = false;
+        std::map<int, DocumentBitmap>::const_iterator rating_documents_begin_;
+        bool is_empty_ = false;
+    };
+
+    // any other predicate, called for every posting of a document that is not removed
+    template <typename DocumentPredicate>
+    class PredicateFilter {
+    public:
+        PredicateFilter(const SearchServer& server, DocumentPredicate document_predicate)
+            : server_(server)
+            , document_predicate_(document_predicate) {
+        }
+
+        bool IsEmpty() const {
+            return false;
+        }
+        bool MayIntersect(DocumentOrdinal, DocumentOrdinal) const {
+            return true;
+        }
+        bool Accepts(DocumentOrdinal ordinal) const {
+            const int document_id = server_.ordinal_to_document_id_[ordinal];
+            return document_id != -1
+                && document_predicate_(document_id, server_.ordinal_to_status_[ordinal], server_.ordinal_to_rating_[ordinal]);
+        }
+        size_t Apply(DocumentOrdinal* ordinals, uint32_t* counts, size_t size) const {
+            size_t kept = 0;
+            for (size_t i = 0; i < size; ++i) {
+                if (Accepts(ordinals[i])) {
+                    ordinals[kept] = ordinals[i];
+                    counts[kept] = counts[i];
+                    ++kept;
+                }
+            }
+            return kept;
+        }
+
+    private:
+        const SearchServer& server_;
+        DocumentPredicate document_predicate_;
+    };
+
+    // a filter limited to the documents of a bitmap
+    template <typename Filter>
+    class BitmapRestrictedFilter {
+    public:
+        BitmapRestrictedFilter(const Filter& filter, const DocumentBitmap& documents)
+            : filter_(filter)
+            , documents_(documents) {
+        }
+
+        bool IsEmpty() const {
+            return documents_.size() == 0 || filter_.IsEmpty();
+        }
+        bool MayIntersect(DocumentOrdinal first, DocumentOrdinal last) const {
+            return documents_.Intersects(first, last) && filter_.MayIntersect(first, last);
+        }
+        bool Accepts(DocumentOrdinal ordinal) const {
+            return documents_.Contains(ordinal) && filter_.Accepts(ordinal);
+        }
+        size_t Apply(DocumentOrdinal* ordinals, uint32_t* counts, size_t size) const {
+            return filter_.Apply(ordinals, counts, documents_.Filter(ordinals, counts, size));
+        }
+
+    private:
+        const Filter& filter_;
+        const DocumentBitmap& documents_;
+    };
+
+    template <typename DocumentPredicate>
+    auto MakeFilter(const DocumentPredicate& document_predicate) const;
+
+    // ordinals scored by one worker of a parallel query, the scores of a range stay in L2 cache
+    static constexpr DocumentOrdinal PARTITION_SIZE = DocumentOrdinal(1) << 14;
+    // a rating filter checks blocks against rating bitmaps only if it takes no more of them,
+    // search by rating walks no more of them one by one
+    static constexpr size_t MAX_PROBED_RATINGS = 8;
+
+    void ThrowIfReadOnly() const;
+    void CompactIfNeeded();
+    void CheckNewDocumentId(int document_id) const;
+    // everything but postings: ordinal, attributes, text and forward index slice
+    DocumentOrdinal StoreDocument(int document_id, std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings, const std::vector<TermCount>& term_counts, uint32_t word_count);
+    void ReleaseDocumentText(DocumentOrdinal ordinal);
+    void ReleaseDocumentTerms(DocumentOrdinal ordinal);
+    // the ordinal becomes a tombstone, returns false for an unknown id
+    template <class ExecutionPolicy>
+    bool MarkDocumentRemoved(ExecutionPolicy&& exe_policy, int document_id) {
+        const auto ordinal_iter = document_to_ordinal_.find(document_id);
+        if (ordinal_iter == document_to_ordinal_.end()) {
+            return false;
+        }
+        const DocumentOrdinal ordinal = ordinal_iter->second;
+        if (log_) {
+            log_->AppendRemove(log_sequence_ + 1, document_id);
+        }
+        ++log_sequence_;
+        const TermCount* terms_begin = forward_index_.data() + ordinal_to_forward_begin_[ordinal];
+
+        // posting lists are not touched, the ordinal becomes a tombstone until Compact.
+        // Only document counts of the terms change, every term has its own counter
+        std::vector<uint32_t>& term_document_counts = term_document_counts_.Mutable();
+        std::for_each(
+            exe_policy,
+            terms_begin,
+            terms_begin + ordinal_to_term_count_[ordinal],
+            [&term_document_counts](const TermCount& term) {
+                --term_document_counts[term.term_id];
+            }
+        );
+
+        ordinal_to_document_id_.Mutable()[ordinal] = -1;
+        ++removed_ordinal_count_;
+        status_to_documents_.at(ordinal_to_status_[ordinal]).Remove(ordinal);
+        rating_to_documents_.at(ordinal_to_rating_[ordinal]).Remove(ordinal);
+        ReleaseDocumentText(ordinal);
+        ReleaseDocumentTerms(ordinal);
+        word_freqs_cache_.erase(document_id);
+        documents_ids_.erase(document_id);
+        document_to_ordinal_.erase(ordinal_iter);
+        return true;
+    }
+
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
     struct QueryWord {
         std::string_view data;
         bool is_minus = false;
-        bool is_stop = false;
     };
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // words are resolved to term ids once while parsing, words absent from the index are dropped
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
     };
     Query ParseQuery(std::execution::parallel_policy, const std::string_view& text) const;
     Query ParseQuery(std::execution::sequenced_policy, const std::string_view& text) const;
+    // fills buffers of the caller, words are only a scratch for splitting
+    void ParseQuery(const std::string_view& text, std::vector<std::string_view>& words, Query& query) const;
+
+    struct ScoredCursor {
+        PostingCursor cursor;
+        double inverse_document_freq;
+        uint64_t max_score;
+    };
 
-    double ComputeWordInverseDocumentFreq(const std::string_view& word) const;
+    // queries of a batch: equal ones are computed once, by the first of them, and the costliest go first
+    struct QueryBatch {
+        std::vector<Query> queries;
+        std::vector<size_t> unique_queries;
+        std::vector<size_t> query_to_unique;
+        // indices into unique_queries
+        std::vector<size_t> schedule;
+    };
+    QueryBatch PlanQueryBatch(const std::vector<std::string>& raw_queries) const;
+
+    static QueryContext& GetThreadQueryContext();
+    // calls func with the context of the calling thread or, if a query of the thread already holds it
+    // (a predicate may search as well), with a new one
+    template <typename Func>
+    static auto WithQueryContext(Func func);
+
+    double ComputeWordInverseDocumentFreq(size_t document_freq) const;
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsInContext(const ExecutionPolicy& policy, QueryContext& context, const std::string_view& raw_query,
+        DocumentPredicate document_predicate, size_t max_document_count) const;
+    // a parsed query goes through the cache if it is enabled and the predicate is a status
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocumentsForQuery(const ExecutionPolicy& policy, QueryContext& context, const Query& query,
+        DocumentPredicate document_predicate, size_t max_document_count) const;
+    // returns the documents sorted, sequential search keeps its heap in the context
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> CollectTopDocuments(const ExecutionPolicy&, QueryContext& context, const Query& query,
+        DocumentPredicate document_predicate, size_t max_document_count) const;
+    // leaves the documents in the collector of the context
+    template <typename DocumentPredicate>
+    void CollectTopDocumentsSequential(QueryContext& context, const Query& query, DocumentPredicate document_predicate,
+        size_t max_document_count) const;
+    template <typename DocumentPredicate>
+    void CollectTopDocumentsExhaustive(QueryContext& context, const Query& query, DocumentPredicate document_predicate) const;
+    // every worker scores one range of ordinals by all words of the query, so no document is shared
+    // between threads. Scores are fixed-point sums, which makes the result equal to the sequential one
+    template <typename DocumentPredicate>
+    TopDocumentsCollector CollectTopDocumentsPartitioned(const Query& query, DocumentPredicate document_predicate,
+        size_t max_document_count) const;
+    template <typename DocumentPredicate>
+    void CollectTopDocumentsMaxScore(QueryContext& context, const Query& query, DocumentPredicate document_predicate) const;
+    // calls func(ordinal, count) for postings of documents accepted by the filter
+    // with ordinals from first_ordinal to last_ordinal inclusive
+    template <typename Filter, typename Func>
+    void ForEachMatchingPosting(const PostingList& postings, const Filter& filter, Func func,
+        DocumentOrdinal first_ordinal = 0, DocumentOrdinal last_ordinal = std::numeric_limits<DocumentOrdinal>::max()) const;
 };
 
+// grow-only scratch buffers of a query: words, parsed terms, scores by ordinal and the heap of the best documents.
+// Once they have grown to the size of the index, a sequential query allocates only the returned vector.
+// Scores take 9 bytes per ordinal of the largest index searched with the context, and a context kept by the caller
+// holds them until it is destroyed. Every thread has a context of its own for the overloads without one:
+// it lives as long as the thread, so it drops its scores after a query over more than MAX_RETAINED_ORDINALS.
+// A context serves one query at a time
+class SearchServer::QueryContext {
+public:
+    QueryContext() = default;
+    QueryContext(const QueryContext&) = delete;
+    QueryContext& operator=(const QueryContext&) = delete;
+
+    // about 9 MB of scores kept by a thread between queries
+    static constexpr size_t MAX_RETAINED_ORDINALS = size_t(1) << 20;
+
+private:
+    friend class SearchServer;
+
+    // marks the context busy for the time of one query
+    class Lease {
+    public:
+        explicit Lease(QueryContext& context)
+            : context_(context)
+            , uncaught_exceptions_(std::uncaught_exceptions()) {
+            if (context_.in_use_) {
+                throw std::logic_error("QueryContext is already used by another query");
+            }
+            context_.in_use_ = true;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() {
+            // a predicate threw in the middle of scoring, the slots it left are not known
+            if (std::uncaught_exceptions() > uncaught_exceptions_) {
+                context_.scores_.Clear();
+            }
+            context_.in_use_ = false;
+        }
+
+    private:
+        QueryContext& context_;
+        int uncaught_exceptions_;
+    };
+
+    std::vector<std::string_view> words_;
+    Query query_;
+    ScoreAccumulator scores_;
+    std::vector<DocumentOrdinal> touched_;
+    std::vector<ScoredCursor> cursors_;
+    std::vector<PostingCursor> minus_cursors_;
+    std::vector<uint64_t> max_score_prefix_;
+    TopDocumentsCollector collector_{ 0 };
+    bool in_use_ = false;
+
+    // for the context of a thread, which would otherwise keep buffers for the largest index until the thread exits
+    void ReleaseLargeBuffers();
+};
+
+template <typename Func>
+auto SearchServer::WithQueryContext(Func func) {
+    QueryContext& context = GetThreadQueryContext();
+    if (context.in_use_) {
+        QueryContext nested_context;
+        return func(nested_context);
+    }
+    auto result = func(context);
+    context.ReleaseLargeBuffers();
+    return result;
+}
+
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view& raw_query,
-    DocumentPredicate document_predicate) const
+    DocumentPredicate document_predicate, size_t max_document_count) const
 {
-    Query query = ParseQuery(std::execution::seq, raw_query);
-    std::vector<Document> matched_documents = FindAllDocuments(policy, query, document_predicate);
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
+    return WithQueryContext([&](QueryContext& context) {
+        return FindTopDocumentsInContext(policy, context, raw_query, document_predicate, max_document_count);
+    });
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsInContext(const ExecutionPolicy& policy, QueryContext& context,
+    const std::string_view& raw_query, DocumentPredicate document_predicate, size_t max_document_count) const
+{
+    QueryContext::Lease lease(context);
+    ParseQuery(raw_query, context.words_, context.query_);
+    return FindTopDocumentsForQuery(policy, context, context.query_, document_predicate, max_document_count);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsForQuery(const ExecutionPolicy& policy, QueryContext& context, const Query& query,
+    DocumentPredicate document_predicate, size_t max_document_count) const
+{
+    if constexpr (std::is_same_v<DocumentPredicate, StatusIs>) {
+        if (query_cache_) {
+            QueryCacheKey key{ query.plus_terms, query.minus_terms, document_predicate.status, max_document_count };
+            if (auto cached = query_cache_->Find(key, log_sequence_)) {
+                return std::move(*cached);
             }
-            else {
-                return lhs.relevance > rhs.relevance;
+            std::vector<Document> result = CollectTopDocuments(policy, context, query, document_predicate, max_document_count);
+            query_cache_->Insert(std::move(key), log_sequence_, result);
+            return result;
+        }
+    }
+    return CollectTopDocuments(policy, context, query, document_predicate, max_document_count);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::CollectTopDocuments(const ExecutionPolicy&, QueryContext& context, const Query& query,
+    DocumentPredicate document_predicate, size_t max_document_count) const
+{
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        CollectTopDocumentsSequential(context, query, document_predicate, max_document_count);
+        return context.collector_.ExtractSortedCopy();
+    }
+    else {
+        return CollectTopDocumentsPartitioned(query, document_predicate, max_document_count).ExtractSorted();
+    }
+}
+
+template <typename DocumentPredicate>
+void SearchServer::CollectTopDocumentsSequential(QueryContext& context, const Query& query, DocumentPredicate document_predicate,
+    size_t max_document_count) const
+{
+    context.collector_.Reset(max_document_count);
+    if (retrieval_mode_ == RetrievalMode::MAX_SCORE) {
+        CollectTopDocumentsMaxScore(context, query, document_predicate);
+    }
+    else {
+        CollectTopDocumentsExhaustive(context, query, document_predicate);
+    }
+}
+
+template <typename DocumentPredicate>
+void SearchServer::CollectTopDocumentsExhaustive(QueryContext& context, const Query& query, DocumentPredicate document_predicate) const {
+    ScoreAccumulator& document_to_relevance = context.scores_;
+    document_to_relevance.Grow(ordinal_to_document_id_.size());
+    std::vector<DocumentOrdinal>& touched = context.touched_;
+    touched.clear();
+    const auto filter = MakeFilter(document_predicate);
+
+    // minus words go first, so plus words skip excluded documents
+    for (const TermId term_id : query.minus_terms) {
+        postings_[term_id].ForEach([&](DocumentOrdinal ordinal, uint32_t) {
+            document_to_relevance.Exclude(ordinal);
+        });
+    }
+    for (const TermId term_id : query.plus_terms) {
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_document_counts_[term_id]);
+        ForEachMatchingPosting(postings_[term_id], filter, [&](DocumentOrdinal ordinal, uint32_t count) {
+            const double term_freq = count * ordinal_to_inv_word_count_[ordinal];
+            if (document_to_relevance.Add(ordinal, term_freq * inverse_document_freq)) {
+                touched.push_back(ordinal);
             }
         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
-    return matched_documents;
+
+    for (const DocumentOrdinal ordinal : touched) {
+        context.collector_.Add({ ordinal_to_document_id_[ordinal], document_to_relevance.GetScore(ordinal), ordinal_to_rating_[ordinal] });
+        document_to_relevance.Reset(ordinal);
+    }
+    // the accumulator is left zeroed for the next query
+    for (const TermId term_id : query.minus_terms) {
+        postings_[term_id].ForEach([&](DocumentOrdinal ordinal, uint32_t) {
+            document_to_relevance.Reset(ordinal);
+        });
+    }
 }
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate) const {
-    const int BUCKET_COUNT = 400;
-    ConcurrentMap<int, double> document_to_relevance(BUCKET_COUNT);
-
-    // parallel execution causes issues in relevance count !
-    const auto func_plus =
-        [&](const std::string_view word) {
-        if (word_to_id_freq_.count(word) != 0) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_id_freq_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+template <typename DocumentPredicate>
+TopDocumentsCollector SearchServer::CollectTopDocumentsPartitioned(const Query& query, DocumentPredicate document_predicate,
+    size_t max_document_count) const
+{
+    constexpr uint8_t TOUCHED = 1;
+    constexpr uint8_t EXCLUDED = 2;
+    const size_t ordinal_count = ordinal_to_document_id_.size();
+    const auto filter = MakeFilter(document_predicate);
+    std::vector<DocumentOrdinal> range_firsts;
+    for (size_t first = 0; first < ordinal_count; first += PARTITION_SIZE) {
+        range_firsts.push_back(static_cast<DocumentOrdinal>(first));
+    }
+
+    return std::transform_reduce(std::execution::par, range_firsts.begin(), range_firsts.end(),
+        TopDocumentsCollector(max_document_count),
+        [](TopDocumentsCollector lhs, const TopDocumentsCollector& rhs) {
+            lhs.Merge(rhs);
+            return lhs;
+        },
+        [&](DocumentOrdinal range_first) {
+            const DocumentOrdinal range_last = static_cast<DocumentOrdinal>(
+                std::min<size_t>(ordinal_count, size_t(range_first) + PARTITION_SIZE) - 1);
+            std::vector<uint64_t> scores(range_last - range_first + 1);
+            std::vector<uint8_t> states(scores.size());
+
+            // minus words go first, so plus words skip excluded documents
+            for (const TermId term_id : query.minus_terms) {
+                postings_[term_id].ForEachInRange(range_first, range_last, [&](DocumentOrdinal ordinal, uint32_t) {
+                    states[ordinal - range_first] = EXCLUDED;
+                });
+            }
+            for (const TermId term_id : query.plus_terms) {
+                const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_document_counts_[term_id]);
+                ForEachMatchingPosting(postings_[term_id], filter, [&](DocumentOrdinal ordinal, uint32_t count) {
+                    const size_t slot = ordinal - range_first;
+                    if (states[slot] != EXCLUDED) {
+                        const double term_freq = count * ordinal_to_inv_word_count_[ordinal];
+                        scores[slot] += ScoreAccumulator::ToFixedPoint(term_freq * inverse_document_freq);
+                        states[slot] = TOUCHED;
+                    }
+                }, range_first, range_last);
+            }
+
+            TopDocumentsCollector collector(max_document_count);
+            for (size_t slot = 0; slot < states.size(); ++slot) {
+                if (states[slot] == TOUCHED) {
+                    const DocumentOrdinal ordinal = range_first + static_cast<DocumentOrdinal>(slot);
+                    collector.Add({ ordinal_to_document_id_[ordinal], ScoreAccumulator::FromFixedPoint(scores[slot]),
+                        ordinal_to_rating_[ordinal] });
                 }
             }
-        }
+            return collector;
+        });
+}
+
+template <typename DocumentPredicate>
+void SearchServer::CollectTopDocumentsMaxScore(QueryContext& context, const Query& query, DocumentPredicate document_predicate) const {
+    std::vector<ScoredCursor>& cursors = context.cursors_;
+    cursors.clear();
+    for (const TermId term_id : query.plus_terms) {
+        const PostingList& postings = postings_[term_id];
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_document_counts_[term_id]);
+        cursors.push_back({ PostingCursor(postings), inverse_document_freq,
+            ScoreAccumulator::ToFixedPoint(postings.GetMaxTermFreq() * inverse_document_freq) });
+    }
+    std::vector<PostingCursor>& minus_cursors = context.minus_cursors_;
+    minus_cursors.clear();
+    for (const TermId term_id : query.minus_terms) {
+        minus_cursors.emplace_back(postings_[term_id]);
+    }
+
+    // least promising words go first, max_score_prefix[i] bounds the score a document gets from words 0..i
+    std::sort(cursors.begin(), cursors.end(),
+        [](const ScoredCursor& lhs, const ScoredCursor& rhs) { return lhs.max_score < rhs.max_score; });
+    std::vector<uint64_t>& max_score_prefix = context.max_score_prefix_;
+    max_score_prefix.resize(cursors.size());
+    uint64_t max_score_sum = 0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        max_score_sum += cursors[i].max_score;
+        max_score_prefix[i] = max_score_sum;
+    }
+
+    TopDocumentsCollector& collector = context.collector_;
+    const auto filter = MakeFilter(document_predicate);
+    if (filter.IsEmpty()) {
+        return;
+    }
+    // scores are compared with a margin, a document within EPSILON of the worst one may still win by rating
+    const auto can_enter = [&collector](uint64_t score_bound) {
+        return !collector.IsFull()
+            || ScoreAccumulator::FromFixedPoint(score_bound) + 2 * EPSILON > collector.GetWorst().relevance;
+    };
+    const auto score_of = [this](const ScoredCursor& scored) {
+        const double term_freq = scored.cursor.GetCount() * ordinal_to_inv_word_count_[scored.cursor.GetOrdinal()];
+        return ScoreAccumulator::ToFixedPoint(term_freq * scored.inverse_document_freq);
     };
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), func_plus);
 
-    auto temp = document_to_relevance.BuildOrdinaryMap();
-    const auto func_minus =
-        [&](const std::string_view word) {
-        if (word_to_id_freq_.count(word) != 0) {
-            for (const auto [document_id, _] : word_to_id_freq_.at(word)) {
-                temp.erase(document_id);
+    // words before first_essential cannot bring a document into the top on their own,
+    // so candidates are taken only from the essential ones
+    size_t first_essential = 0;
+    while (first_essential < cursors.size()) {
+        bool has_candidate = false;
+        DocumentOrdinal candidate = 0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].cursor.IsEnd() && (!has_candidate || cursors[i].cursor.GetOrdinal() < candidate)) {
+                candidate = cursors[i].cursor.GetOrdinal();
+                has_candidate = true;
             }
         }
-    };
-    std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), func_minus);
-
-
-    // this is stable version
-    //for (const std::string_view& word : query.plus_words) {
-    //    if (word_to_id_freq_.count(word) == 0) {
-    //        continue;
-    //    }
-    //    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-    //    for (const auto [document_id, term_freq] : word_to_id_freq_.at(word)) {
-    //        const auto& document_data = documents_.at(document_id);
-    //        if (document_predicate(document_id, document_data.status, document_data.rating)) {
-    //            document_to_relevance[document_id] += term_freq * inverse_document_freq;
-    //        }
-    //    }
-    //}
-
-    //for (const std::string_view& word : query.minus_words) {
-    //    if (word_to_id_freq_.count(word) == 0) {
-    //        continue;
-    //    }
-    //    for (const auto [document_id, _] : word_to_id_freq_.at(word)) {
-    //        document_to_relevance.erase(document_id);
-    //    }
-    //}
-
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : temp) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
-    }
-    return matched_documents;
+        if (!has_candidate) {
+            break;
+        }
+
+        uint64_t score = 0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            PostingCursor& cursor = cursors[i].cursor;
+            if (!cursor.IsEnd() && cursor.GetOrdinal() == candidate) {
+                score += score_of(cursors[i]);
+                cursor.Next();
+            }
+        }
+        // known filters are cheap, a document they reject is dropped before probing the other words
+        if constexpr (IsDocumentFilter<DocumentPredicate>::value) {
+            if (!filter.Accepts(candidate)) {
+                continue;
+            }
+        }
+
+        bool is_pruned = false;
+        for (size_t i = first_essential; i-- > 0;) {
+            const uint64_t rest_bound = i > 0 ? max_score_prefix[i - 1] : 0;
+            ScoredCursor& scored = cursors[i];
+            const uint64_t block_bound = ScoreAccumulator::ToFixedPoint(
+                scored.cursor.GetBlockMaxTermFreq(candidate) * scored.inverse_document_freq);
+            if (!can_enter(score + block_bound + rest_bound)) {
+                is_pruned = true;
+                break;
+            }
+            scored.cursor.NextGeq(candidate);
+            if (!scored.cursor.IsEnd() && scored.cursor.GetOrdinal() == candidate) {
+                score += score_of(scored);
+            }
+        }
+        if (is_pruned || !can_enter(score)) {
+            continue;
+        }
+
+        const bool has_minus_word = std::any_of(minus_cursors.begin(), minus_cursors.end(),
+            [candidate](PostingCursor& cursor) {
+                cursor.NextGeq(candidate);
+                return !cursor.IsEnd() && cursor.GetOrdinal() == candidate;
+            });
+        if (has_minus_word) {
+            continue;
+        }
+        if constexpr (!IsDocumentFilter<DocumentPredicate>::value) {
+            if (!filter.Accepts(candidate)) {
+                continue;
+            }
+        }
+        collector.Add({ ordinal_to_document_id_[candidate], ScoreAccumulator::FromFixedPoint(score), ordinal_to_rating_[candidate] });
+
+        while (first_essential < cursors.size() && !can_enter(max_score_prefix[first_essential])) {
+            ++first_essential;
+        }
+    }
+}
+
+template <typename Func>
+void SearchServer::ForEachDocumentTerm(int document_id, Func func) const {
+    const auto ordinal_iter = document_to_ordinal_.find(document_id);
+    if (ordinal_iter == document_to_ordinal_.end()) {
+        return;
+    }
+    const DocumentOrdinal ordinal = ordinal_iter->second;
+    const TermCount* terms_begin = forward_index_.data() + ordinal_to_forward_begin_[ordinal];
+    for (const TermCount* term = terms_begin; term != terms_begin + ordinal_to_term_count_[ordinal]; ++term) {
+        func(term->term_id);
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByRating(const std::string_view& raw_query, DocumentPredicate document_predicate,
+    size_t max_document_count) const
+{
+    return WithQueryContext([&](QueryContext& context) {
+        QueryContext::Lease lease(context);
+        ParseQuery(raw_query, context.words_, context.query_);
+        const Query& query = context.query_;
+        const auto filter = MakeFilter(document_predicate);
+        ScoreAccumulator& document_to_relevance = context.scores_;
+        document_to_relevance.Grow(ordinal_to_document_id_.size());
+        std::vector<DocumentOrdinal>& touched = context.touched_;
+        for (const TermId term_id : query.minus_terms) {
+            postings_[term_id].ForEach([&](DocumentOrdinal ordinal, uint32_t) {
+                document_to_relevance.Exclude(ordinal);
+            });
+        }
+
+        // the highest ratings are scored one by one, so they are complete before lower ones are touched.
+        // Every rating costs a walk over the plus-word lists, so after a few of them the rest are scored together
+        std::vector<Document> result;
+        TopDocumentsCollector& collector = context.collector_;
+        auto rating_iter = rating_to_documents_.rbegin();
+        for (size_t probed_ratings = 0; rating_iter != rating_to_documents_.rend() && result.size() < max_document_count
+            && probed_ratings < MAX_PROBED_RATINGS; ++rating_iter)
+        {
+            if (rating_iter->second.size() == 0) {
+                continue;
+            }
+            ++probed_ratings;
+            const BitmapRestrictedFilter rating_filter(filter, rating_iter->second);
+            touched.clear();
+            for (const TermId term_id : query.plus_terms) {
+                const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_document_counts_[term_id]);
+                ForEachMatchingPosting(postings_[term_id], rating_filter, [&](DocumentOrdinal ordinal, uint32_t count) {
+                    const double term_freq = count * ordinal_to_inv_word_count_[ordinal];
+                    if (document_to_relevance.Add(ordinal, term_freq * inverse_document_freq)) {
+                        touched.push_back(ordinal);
+                    }
+                });
+            }
+            collector.Reset(max_document_count - result.size());
+            for (const DocumentOrdinal ordinal : touched) {
+                collector.Add({ ordinal_to_document_id_[ordinal], document_to_relevance.GetScore(ordinal), ordinal_to_rating_[ordinal] });
+                document_to_relevance.Reset(ordinal);
+            }
+            const std::vector<Document> rating_documents = collector.ExtractSortedCopy();
+            result.insert(result.end(), rating_documents.begin(), rating_documents.end());
+        }
+
+        if (rating_iter != rating_to_documents_.rend() && result.size() < max_document_count) {
+            const int max_rest_rating = rating_iter->first;
+            touched.clear();
+            for (const TermId term_id : query.plus_terms) {
+                const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_document_counts_[term_id]);
+                ForEachMatchingPosting(postings_[term_id], filter, [&](DocumentOrdinal ordinal, uint32_t count) {
+                    if (ordinal_to_rating_[ordinal] > max_rest_rating) {
+                        return;
+                    }
+                    const double term_freq = count * ordinal_to_inv_word_count_[ordinal];
+                    if (document_to_relevance.Add(ordinal, term_freq * inverse_document_freq)) {
+                        touched.push_back(ordinal);
+                    }
+                });
+            }
+            std::vector<Document> rest_documents;
+            rest_documents.reserve(touched.size());
+            for (const DocumentOrdinal ordinal : touched) {
+                rest_documents.push_back({ ordinal_to_document_id_[ordinal], document_to_relevance.GetScore(ordinal), ordinal_to_rating_[ordinal] });
+                document_to_relevance.Reset(ordinal);
+            }
+            const size_t rest_count = std::min(rest_documents.size(), max_document_count - result.size());
+            std::partial_sort(rest_documents.begin(), rest_documents.begin() + rest_count, rest_documents.end(),
+                [](const Document& lhs, const Document& rhs) {
+                    return lhs.rating > rhs.rating || (lhs.rating == rhs.rating && IsMoreRelevant(lhs, rhs));
+                });
+            result.insert(result.end(), rest_documents.begin(), rest_documents.begin() + rest_count);
+        }
+
+        for (const TermId term_id : query.minus_terms) {
+            postings_[term_id].ForEach([&](DocumentOrdinal ordinal, uint32_t) {
+                document_to_relevance.Reset(ordinal);
+            });
+        }
+        return result;
+    });
+}
+
+template <typename DocumentPredicate>
+auto SearchServer::MakeFilter(const DocumentPredicate& document_predicate) const {
+    if constexpr (IsDocumentFilter<DocumentPredicate>::value) {
+        OrdinalFilter filter(*this);
+        filter.Require(document_predicate);
+        return filter;
+    }
+    else {
+        return PredicateFilter<DocumentPredicate>(*this, document_predicate);
+    }
+}
+
+template <typename Filter, typename Func>
+void SearchServer::ForEachMatchingPosting(const PostingList& postings, const Filter& filter, Func func,
+    DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const
+{
+    if (filter.IsEmpty()) {
+        return;
+    }
+    DocumentOrdinal ordinals[PostingList::BLOCK_SIZE];
+    uint32_t counts[PostingList::BLOCK_SIZE];
+    for (size_t block = postings.FindBlock(first_ordinal);
+        block < postings.GetBlockCount() && postings.GetBlockFirstOrdinal(block) <= last_ordinal; ++block)
+    {
+        if (!filter.MayIntersect(std::max(first_ordinal, postings.GetBlockFirstOrdinal(block)),
+            std::min(last_ordinal, postings.GetBlockLastOrdinal(block))))
+        {
+            continue;
+        }
+        const size_t decoded_size = postings.DecodeBlock(block, ordinals, counts);
+        // only blocks at the ends of the range hold postings outside of it
+        const size_t begin = std::lower_bound(ordinals, ordinals + decoded_size, first_ordinal) - ordinals;
+        const size_t end = std::upper_bound(ordinals + begin, ordinals + decoded_size, last_ordinal) - ordinals;
+        const size_t kept = filter.Apply(ordinals + begin, counts + begin, end - begin);
+        for (size_t i = begin; i < begin + kept; ++i) {
+            func(ordinals[i], counts[i]);
+        }
+    }
 }
\ No newline at end of file
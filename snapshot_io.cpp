@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cstring>
+#include "snapshot_io.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+// written as is, a snapshot from a machine with another byte order is rejected
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const size_t ALIGNMENT = 8;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t payload_size;
+    uint64_t checksum;
+    uint64_t reserved;
+};
+
+class HeapSnapshotBuffer : public SnapshotBuffer {
+public:
+    explicit HeapSnapshotBuffer(size_t size)
+        // 64-bit words keep every array of the payload aligned
+        : words_(new uint64_t[(size + ALIGNMENT - 1) / ALIGNMENT])
+        , size_(size) {
+    }
+
+    const char* data() const override {
+        return reinterpret_cast<const char*>(words_.get());
+    }
+    char* data() {
+        return reinterpret_cast<char*>(words_.get());
+    }
+    size_t size() const override {
+        return size_;
+    }
+
+private:
+    std::unique_ptr<uint64_t[]> words_;
+    size_t size_;
+};
+
+// pages of the file mapped read-only: they are shared with other processes through the page cache
+// and read from disk only when touched
+class MappedSnapshotBuffer : public SnapshotBuffer {
+public:
+    explicit MappedSnapshotBuffer(const std::string& path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Cannot open snapshot " + path);
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file_);
+            throw std::runtime_error("Cannot map snapshot " + path);
+        }
+        size_ = static_cast<size_t>(file_size.QuadPart);
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data_ = mapping_ != nullptr ? static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (data_ == nullptr) {
+            if (mapping_ != nullptr) {
+                CloseHandle(mapping_);
+            }
+            CloseHandle(file_);
+            throw std::runtime_error("Cannot map snapshot " + path);
+        }
+#else
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("Cannot open snapshot " + path);
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+            close(fd);
+            throw std::runtime_error("Cannot map snapshot " + path);
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        // the mapping stays valid after the descriptor is closed
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("Cannot map snapshot " + path);
+        }
+        data_ = static_cast<const char*>(data);
+#endif
+    }
+
+    MappedSnapshotBuffer(const MappedSnapshotBuffer&) = delete;
+    MappedSnapshotBuffer& operator=(const MappedSnapshotBuffer&) = delete;
+
+    ~MappedSnapshotBuffer() override {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+#else
+        munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    const char* data() const override {
+        return data_;
+    }
+    size_t size() const override {
+        return size_;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace
+
+std::shared_ptr<const SnapshotBuffer> MapSnapshotFile(const std::string& path) {
+    return std::make_shared<MappedSnapshotBuffer>(path);
+}
+
+void SyncSnapshotFile(const std::string& path) {
+#ifdef _WIN32
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    const bool is_synced = file != INVALID_HANDLE_VALUE && FlushFileBuffers(file);
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    const bool is_synced = fd != -1 && fsync(fd) == 0;
+    if (fd != -1) {
+        close(fd);
+    }
+#endif
+    if (!is_synced) {
+        throw std::runtime_error("Cannot sync snapshot " + path);
+    }
+}
+
+#ifdef _WIN32
+// NTFS journals renames itself, a directory cannot be flushed there
+void SyncSnapshotDirectory(const std::string&) {
+}
+#else
+void SyncSnapshotDirectory(const std::string& path) {
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    if (directory.empty()) {
+        directory = ".";
+    }
+    const int fd = open(directory.c_str(), O_RDONLY);
+    const bool is_synced = fd != -1 && fsync(fd) == 0;
+    if (fd != -1) {
+        close(fd);
+    }
+    if (!is_synced) {
+        throw std::runtime_error("Cannot sync directory of snapshot " + path);
+    }
+}
+#endif
+
+std::shared_ptr<const SnapshotBuffer> ReadSnapshotFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Cannot open snapshot " + path);
+    }
+    const size_t size = static_cast<size_t>(in.tellg());
+    auto buffer = std::make_shared<HeapSnapshotBuffer>(size);
+    in.seekg(0);
+    if (!in.read(buffer->data(), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Cannot read snapshot " + path);
+    }
+    return buffer;
+}
+
+void SnapshotChecksum::Update(const char* data, size_t size) {
+    // bytes are gathered into 64-bit words, so the result does not depend on how the input is split
+    while (size > 0 && pending_size_ > 0) {
+        pending_ |= uint64_t(static_cast<unsigned char>(*data)) << (8 * pending_size_);
+        ++data;
+        --size;
+        if (++pending_size_ == ALIGNMENT) {
+            Mix(pending_);
+            pending_ = 0;
+            pending_size_ = 0;
+        }
+    }
+    for (; size >= ALIGNMENT; data += ALIGNMENT, size -= ALIGNMENT) {
+        uint64_t word = 0;
+        for (size_t i = 0; i < ALIGNMENT; ++i) {
+            word |= uint64_t(static_cast<unsigned char>(data[i])) << (8 * i);
+        }
+        Mix(word);
+    }
+    for (; size > 0; ++data, --size) {
+        pending_ |= uint64_t(static_cast<unsigned char>(*data)) << (8 * pending_size_++);
+    }
+}
+
+uint64_t SnapshotChecksum::Get() const {
+    uint64_t state = state_;
+    if (pending_size_ > 0) {
+        state = (state ^ pending_) * 0x9E3779B97F4A7C15;
+    }
+    return state ^ (state >> 29);
+}
+
+void SnapshotChecksum::Mix(uint64_t word) {
+    state_ = ((state_ ^ word) * 0x9E3779B97F4A7C15);
+    state_ = (state_ << 31) | (state_ >> 33);
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : out_(path, std::ios::binary | std::ios::trunc) {
+    if (!out_) {
+        throw std::runtime_error("Cannot create snapshot " + path);
+    }
+    // the header is written last, when the payload size and checksum are known
+    const SnapshotHeader header = {};
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void SnapshotWriter::EndArray() {
+    const char padding[ALIGNMENT] = {};
+    WriteBytes(padding, (ALIGNMENT - payload_size_ % ALIGNMENT) % ALIGNMENT);
+}
+
+void SnapshotWriter::Finish() {
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.payload_size = payload_size_;
+    header.checksum = checksum_.Get();
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.flush();
+    if (!out_) {
+        throw std::runtime_error("Cannot write snapshot");
+    }
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    checksum_.Update(static_cast<const char*>(data), size);
+    payload_size_ += size;
+}
+
+SnapshotReader::SnapshotReader(std::shared_ptr<const SnapshotBuffer> buffer, bool verify_checksum)
+    : buffer_(std::move(buffer))
+    , position_(sizeof(SnapshotHeader)) {
+    if (buffer_->size() < sizeof(SnapshotHeader)) {
+        throw std::runtime_error("Snapshot is corrupted: no header");
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, buffer_->data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("Not a search server snapshot");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(header.version));
+    }
+    if (header.byte_order != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Snapshot was written on a machine with another byte order");
+    }
+    if (header.payload_size != buffer_->size() - sizeof(SnapshotHeader)) {
+        throw std::runtime_error("Snapshot is corrupted: wrong size");
+    }
+    if (verify_checksum) {
+        SnapshotChecksum checksum;
+        checksum.Update(buffer_->data() + sizeof(SnapshotHeader), header.payload_size);
+        if (checksum.Get() != header.checksum) {
+            throw std::runtime_error("Snapshot is corrupted: checksum mismatch");
+        }
+    }
+}
+
+const std::shared_ptr<const SnapshotBuffer>& SnapshotReader::GetBuffer() const {
+    return buffer_;
+}
+
+const char* SnapshotReader::ReadArrayBytes(size_t element_size, size_t& count) {
+    uint64_t array_header[2];
+    if (buffer_->size() - position_ < sizeof(array_header)) {
+        throw std::runtime_error("Snapshot is corrupted: unexpected end");
+    }
+    std::memcpy(array_header, buffer_->data() + position_, sizeof(array_header));
+    position_ += sizeof(array_header);
+    if (array_header[1] != element_size) {
+        throw std::runtime_error("Snapshot is corrupted: unexpected element size");
+    }
+    if (array_header[0] > (buffer_->size() - position_) / element_size) {
+        throw std::runtime_error("Snapshot is corrupted: array does not fit");
+    }
+    count = static_cast<size_t>(array_header[0]);
+    const char* elements = buffer_->data() + position_;
+    position_ += (count * element_size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    position_ = std::min(position_, buffer_->size());
+    return elements;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "mappable_vector.h"
+
+// Index snapshots are flat binary files: a fixed header and a payload of arrays.
+// Every array is written as element count, element size and the elements padded to 8 bytes,
+// so once the payload is in memory the arrays are used in place, nothing is parsed
+const uint32_t SNAPSHOT_VERSION = 3;
+
+// bytes of a snapshot, structures opened from the snapshot refer to them
+class SnapshotBuffer {
+public:
+    virtual ~SnapshotBuffer() = default;
+    virtual const char* data() const = 0;
+    virtual size_t size() const = 0;
+};
+
+// reads the whole file with one bulk read
+std::shared_ptr<const SnapshotBuffer> ReadSnapshotFile(const std::string& path);
+// maps the file into memory read-only, nothing is read until it is accessed
+std::shared_ptr<const SnapshotBuffer> MapSnapshotFile(const std::string& path);
+// forces a written snapshot file to disk
+void SyncSnapshotFile(const std::string& path);
+// forces the entries of the directory holding path to disk, so a rename into it survives power loss
+void SyncSnapshotDirectory(const std::string& path);
+
+// order dependent 64-bit checksum fed with arbitrary pieces of bytes
+class SnapshotChecksum {
+public:
+    void Update(const char* data, size_t size);
+    uint64_t Get() const;
+
+private:
+    uint64_t state_ = 0x243F6A8885A308D3;
+    uint64_t pending_ = 0;
+    size_t pending_size_ = 0;
+
+    void Mix(uint64_t word);
+};
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        WriteArray(&value, 1);
+    }
+    template <typename T>
+    void WriteArray(const T* data, size_t count) {
+        BeginArray<T>(count);
+        WriteElements(data, count);
+        EndArray();
+    }
+    template <typename T>
+    void WriteArray(const std::vector<T>& elements) {
+        WriteArray(elements.data(), elements.size());
+    }
+    template <typename T>
+    void WriteArray(const MappableVector<T>& elements) {
+        WriteArray(elements.data(), elements.size());
+    }
+
+    // an array written in pieces: exactly count elements must follow before EndArray
+    template <typename T>
+    void BeginArray(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain data goes to a snapshot");
+        const uint64_t array_header[2] = { count, sizeof(T) };
+        WriteBytes(array_header, sizeof(array_header));
+    }
+    template <typename T>
+    void WriteElements(const T* data, size_t count) {
+        WriteBytes(data, count * sizeof(T));
+    }
+    void EndArray();
+
+    // writes the header, the file is not a valid snapshot before this call
+    void Finish();
+
+private:
+    std::ofstream out_;
+    uint64_t payload_size_ = 0;
+    SnapshotChecksum checksum_;
+
+    void WriteBytes(const void* data, size_t size);
+};
+
+class SnapshotReader {
+public:
+    // checks the header, the checksum of the payload is checked only if asked:
+    // it takes a pass over the whole buffer
+    SnapshotReader(std::shared_ptr<const SnapshotBuffer> buffer, bool verify_checksum);
+
+    template <typename T>
+    T ReadValue() {
+        const MappableVector<T> array = ReadArray<T>();
+        if (array.size() != 1) {
+            throw std::runtime_error("Snapshot is corrupted: a single value expected");
+        }
+        return array[0];
+    }
+    // the result refers to the buffer
+    template <typename T>
+    MappableVector<T> ReadArray() {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain data comes from a snapshot");
+        size_t count = 0;
+        const char* elements = ReadArrayBytes(sizeof(T), count);
+        return MappableVector<T>::Refer(reinterpret_cast<const T*>(elements), count);
+    }
+
+    const std::shared_ptr<const SnapshotBuffer>& GetBuffer() const;
+
+private:
+    std::shared_ptr<const SnapshotBuffer> buffer_;
+    size_t position_ = 0;
+
+    const char* ReadArrayBytes(size_t element_size, size_t& count);
+};
\ No newline at end of file
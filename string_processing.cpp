@@ -1,5 +1,44 @@
+#include <cstdint>
 #include "string_processing.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRING_PROCESSING_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+bool IsControlCharacter(char c) {
+    return static_cast<unsigned char>(c) < static_cast<unsigned char>(' ');
+}
+
+#ifdef STRING_PROCESSING_SSE2
+const size_t CHUNK_SIZE = 16;
+
+size_t CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// bit i of the result is set if byte i of the chunk is a space, control bytes are or-ed into controls
+uint32_t FindSpaces(const char* chunk, __m128i& controls) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk));
+    // unsigned byte <= 0x1F: the minimum with 0x1F leaves such bytes unchanged
+    controls = _mm_or_si128(controls, _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(0x1F)), bytes));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))));
+}
+#endif
+
+} // namespace
+
 std::vector<std::string> SplitIntoWords(const std::string& text) {
     std::vector<std::string> words;
     std::string word;
@@ -23,18 +62,53 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
 
 std::vector<std::string_view> SplitIntoWordsView(const std::string_view& text) {
     std::vector<std::string_view> words;
-    size_t pos(0);
-    size_t pos_end(text.npos);
-    while (true) {
-        size_t space = text.find(' ', pos);
-        words.push_back(space == pos_end ? text.substr(pos) : text.substr(pos, space - pos));
-        if (space == pos_end) {
-            break;
+    SplitIntoWordsView(text, words);
+    return words;
+}
+
+bool SplitIntoWordsView(std::string_view text, std::vector<std::string_view>& words) {
+    words.clear();
+    size_t word_begin = 0;
+    size_t pos = 0;
+    bool has_controls = false;
+#ifdef STRING_PROCESSING_SSE2
+    // 16 bytes are checked at once, every set bit of the mask ends a word
+    __m128i controls = _mm_setzero_si128();
+    for (; pos + CHUNK_SIZE <= text.size(); pos += CHUNK_SIZE) {
+        for (uint32_t spaces = FindSpaces(text.data() + pos, controls); spaces != 0; spaces &= spaces - 1) {
+            const size_t space = pos + CountTrailingZeros(spaces);
+            words.push_back(text.substr(word_begin, space - word_begin));
+            word_begin = space + 1;
         }
-        else {
-            pos = space + 1;
+    }
+    has_controls = _mm_movemask_epi8(controls) != 0;
+#endif
+    for (; pos < text.size(); ++pos) {
+        has_controls |= IsControlCharacter(text[pos]);
+        if (text[pos] == ' ') {
+            words.push_back(text.substr(word_begin, pos - word_begin));
+            word_begin = pos + 1;
         }
     }
+    words.push_back(text.substr(word_begin));
+    return !has_controls;
+}
 
-    return words;
+bool HasNoControlCharacters(std::string_view text) {
+    size_t pos = 0;
+#ifdef STRING_PROCESSING_SSE2
+    __m128i controls = _mm_setzero_si128();
+    for (; pos + CHUNK_SIZE <= text.size(); pos += CHUNK_SIZE) {
+        FindSpaces(text.data() + pos, controls);
+    }
+    if (_mm_movemask_epi8(controls) != 0) {
+        return false;
+    }
+#endif
+    for (; pos < text.size(); ++pos) {
+        if (IsControlCharacter(text[pos])) {
+            return false;
+        }
+    }
+    return true;
 }
\ No newline at end of file
@@ -16,4 +16,9 @@ std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings)
 }
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
-std::vector<std::string_view> SplitIntoWordsView(const std::string_view& text);
\ No newline at end of file
+std::vector<std::string_view> SplitIntoWordsView(const std::string_view& text);
+// splits text the same way into a buffer that is reused between calls. In the same pass over the bytes
+// it looks for control characters (codes below ' ') and returns false if there are any
+bool SplitIntoWordsView(std::string_view text, std::vector<std::string_view>& words);
+// true if text has no control characters
+bool HasNoControlCharacters(std::string_view text);
\ No newline at end of file
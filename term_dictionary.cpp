@@ -0,0 +1,130 @@
+#include <functional>
+#include <stdexcept>
+#include "term_dictionary.h"
+
+TermDictionary::TermDictionary()
+    : slots_(INITIAL_SLOT_COUNT, EMPTY_SLOT) {
+}
+
+TermId TermDictionary::Add(std::string_view term) {
+    const uint32_t hash = Hash(term);
+    size_t slot = FindSlot(term, hash);
+    if (slots_[slot] != EMPTY_SLOT) {
+        return slots_[slot];
+    }
+    if (2 * (entries_.size() + 1) > slots_.size()) {
+        Grow();
+        slot = FindSlot(term, hash);
+    }
+    // the arena never moves the bytes, views in entries keep pointing to live strings
+    return Insert(slot, term_bytes_.Append(term), hash, false);
+}
+
+TermId TermDictionary::AddStopWord(std::string_view term) {
+    const TermId term_id = Add(term);
+    entries_[term_id].is_stop_word = true;
+    return term_id;
+}
+
+std::optional<TermId> TermDictionary::Find(std::string_view term) const {
+    const TermId term_id = slots_[FindSlot(term, Hash(term))];
+    if (term_id == EMPTY_SLOT) {
+        return std::nullopt;
+    }
+    return term_id;
+}
+
+std::string_view TermDictionary::GetTerm(TermId term_id) const {
+    return entries_.at(term_id).term;
+}
+
+bool TermDictionary::IsStopWord(TermId term_id) const {
+    return entries_.at(term_id).is_stop_word;
+}
+
+size_t TermDictionary::size() const {
+    return entries_.size();
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    std::vector<uint64_t> term_ends;
+    std::vector<uint8_t> stop_word_flags;
+    term_ends.reserve(entries_.size());
+    stop_word_flags.reserve(entries_.size());
+    uint64_t term_end = 0;
+    for (const Entry& entry : entries_) {
+        term_end += entry.term.size();
+        term_ends.push_back(term_end);
+        stop_word_flags.push_back(entry.is_stop_word ? 1 : 0);
+    }
+    writer.WriteArray(term_ends);
+    writer.WriteArray(stop_word_flags);
+    writer.BeginArray<char>(term_end);
+    for (const Entry& entry : entries_) {
+        writer.WriteElements(entry.term.data(), entry.term.size());
+    }
+    writer.EndArray();
+}
+
+TermDictionary TermDictionary::Load(SnapshotReader& reader) {
+    const MappableVector<uint64_t> term_ends = reader.ReadArray<uint64_t>();
+    const MappableVector<uint8_t> stop_word_flags = reader.ReadArray<uint8_t>();
+    const MappableVector<char> term_bytes = reader.ReadArray<char>();
+    if (stop_word_flags.size() != term_ends.size() || (!term_ends.empty() && term_ends.back() != term_bytes.size())) {
+        throw std::runtime_error("Snapshot is corrupted: term dictionary does not match");
+    }
+
+    TermDictionary dictionary;
+    // the table is rebuilt rather than stored, so it does not depend on the hash function of the writer
+    size_t slot_count = INITIAL_SLOT_COUNT;
+    while (slot_count < 2 * term_ends.size()) {
+        slot_count *= 2;
+    }
+    dictionary.slots_.assign(slot_count, EMPTY_SLOT);
+    dictionary.entries_.reserve(term_ends.size());
+    uint64_t term_begin = 0;
+    for (size_t i = 0; i < term_ends.size(); ++i) {
+        if (term_ends[i] < term_begin) {
+            throw std::runtime_error("Snapshot is corrupted: term dictionary does not match");
+        }
+        const std::string_view term(term_bytes.data() + term_begin, static_cast<size_t>(term_ends[i] - term_begin));
+        const uint32_t hash = Hash(term);
+        dictionary.Insert(dictionary.FindSlot(term, hash), term, hash, stop_word_flags[i] != 0);
+        term_begin = term_ends[i];
+    }
+    return dictionary;
+}
+
+uint32_t TermDictionary::Hash(std::string_view term) {
+    return static_cast<uint32_t>(std::hash<std::string_view>{}(term));
+}
+
+size_t TermDictionary::FindSlot(std::string_view term, uint32_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const TermId term_id = slots_[slot];
+        // stored hashes reject almost all other words without touching their bytes
+        if (term_id == EMPTY_SLOT || (entries_[term_id].hash == hash && entries_[term_id].term == term)) {
+            return slot;
+        }
+    }
+}
+
+TermId TermDictionary::Insert(size_t slot, std::string_view term, uint32_t hash, bool is_stop_word) {
+    const TermId term_id = static_cast<TermId>(entries_.size());
+    entries_.push_back({ term, hash, is_stop_word });
+    slots_[slot] = term_id;
+    return term_id;
+}
+
+void TermDictionary::Grow() {
+    slots_.assign(2 * slots_.size(), EMPTY_SLOT);
+    const size_t mask = slots_.size() - 1;
+    for (TermId term_id = 0; term_id < entries_.size(); ++term_id) {
+        size_t slot = entries_[term_id].hash & mask;
+        while (slots_[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = term_id;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "snapshot_io.h"
+#include "text_arena.h"
+
+using TermId = uint32_t;
+
+// gives every indexed word a dense id and owns the bytes of the word,
+// so string_views handed out by the dictionary stay valid after documents are removed.
+// Words are kept in an open-addressing hash table with linear probing,
+// looking a word up by string_view takes one probe sequence and allocates nothing
+class TermDictionary {
+public:
+    TermDictionary();
+
+    TermId Add(std::string_view term);
+    // stop words are ordinary entries marked with a flag, so a token is checked with the same lookup
+    TermId AddStopWord(std::string_view term);
+    std::optional<TermId> Find(std::string_view term) const;
+
+    std::string_view GetTerm(TermId term_id) const;
+    bool IsStopWord(TermId term_id) const;
+    size_t size() const;
+
+    void Save(SnapshotWriter& writer) const;
+    // terms of the loaded dictionary refer to the reader's buffer, it must outlive the dictionary
+    static TermDictionary Load(SnapshotReader& reader);
+
+private:
+    struct Entry {
+        std::string_view term;
+        uint32_t hash;
+        bool is_stop_word;
+    };
+
+    static constexpr uint32_t EMPTY_SLOT = ~uint32_t(0);
+    static constexpr size_t INITIAL_SLOT_COUNT = 16;
+
+    TextArena term_bytes_;
+    std::vector<Entry> entries_;
+    // term ids or EMPTY_SLOT, the size is a power of two and at most half of the slots are taken
+    std::vector<TermId> slots_;
+
+    static uint32_t Hash(std::string_view term);
+    TermId Insert(size_t slot, std::string_view term, uint32_t hash, bool is_stop_word);
+    // slot holding the term or the empty slot where it would be put
+    size_t FindSlot(std::string_view term, uint32_t hash) const;
+    void Grow();
+};
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include <cstring>
+#include "text_arena.h"
+
+TextArena::TextArena(size_t slab_size)
+    : slab_size_(slab_size) {
+}
+
+std::string_view TextArena::Append(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    char* destination;
+    // a string larger than a quarter of a slab gets its own allocation,
+    // the rest of the current slab is kept for next strings
+    if (text.size() > slab_size_ / 4) {
+        slabs_.emplace_back(new char[text.size()]);
+        allocated_bytes_ += text.size();
+        destination = slabs_.back().get();
+    }
+    else {
+        if (free_size_ < text.size()) {
+            slabs_.emplace_back(new char[slab_size_]);
+            allocated_bytes_ += slab_size_;
+            free_begin_ = slabs_.back().get();
+            free_size_ = slab_size_;
+        }
+        destination = free_begin_;
+        free_begin_ += text.size();
+        free_size_ -= text.size();
+    }
+    std::memcpy(destination, text.data(), text.size());
+    used_bytes_ += text.size();
+    return { destination, text.size() };
+}
+
+size_t TextArena::GetUsedBytes() const {
+    return used_bytes_;
+}
+
+size_t TextArena::GetAllocatedBytes() const {
+    return allocated_bytes_;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// append-only storage for many short strings. Bytes are copied into large slabs, so there is
+// one allocation per slab instead of one per string, and returned views stay valid
+// as long as the arena lives
+class TextArena {
+public:
+    static constexpr size_t DEFAULT_SLAB_SIZE = size_t(1) << 20;
+
+    explicit TextArena(size_t slab_size = DEFAULT_SLAB_SIZE);
+
+    std::string_view Append(std::string_view text);
+
+    // bytes of all appended strings
+    size_t GetUsedBytes() const;
+    size_t GetAllocatedBytes() const;
+
+private:
+    size_t slab_size_;
+    std::vector<std::unique_ptr<char[]>> slabs_;
+    char* free_begin_ = nullptr;
+    size_t free_size_ = 0;
+    size_t used_bytes_ = 0;
+    size_t allocated_bytes_ = 0;
+};
\ No newline at end of file
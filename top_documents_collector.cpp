@@ -0,0 +1,61 @@
+#include <algorithm>
+#include "top_documents_collector.h"
+
+TopDocumentsCollector::TopDocumentsCollector(size_t max_count)
+    : max_count_(max_count) {
+    heap_.reserve(max_count_);
+}
+
+void TopDocumentsCollector::Add(const Document& document) {
+    if (heap_.size() < max_count_) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+    else if (max_count_ > 0 && IsMoreRelevant(document, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+void TopDocumentsCollector::Merge(const TopDocumentsCollector& other) {
+    for (const Document& document : other.heap_) {
+        Add(document);
+    }
+}
+
+bool TopDocumentsCollector::IsFull() const {
+    return max_count_ > 0 && heap_.size() == max_count_;
+}
+
+const Document& TopDocumentsCollector::GetWorst() const {
+    return heap_.front();
+}
+
+std::vector<Document> TopDocumentsCollector::ExtractSorted() {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    std::vector<Document> result = std::move(heap_);
+    heap_.clear();
+    return result;
+}
+
+std::vector<Document> TopDocumentsCollector::ExtractSortedCopy() {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    std::vector<Document> result(heap_.begin(), heap_.end());
+    heap_.clear();
+    return result;
+}
+
+size_t TopDocumentsCollector::ExtractSortedTo(Document* out) {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    std::copy(heap_.begin(), heap_.end(), out);
+    const size_t count = heap_.size();
+    heap_.clear();
+    return count;
+}
+
+void TopDocumentsCollector::Reset(size_t max_count) {
+    max_count_ = max_count;
+    heap_.clear();
+    heap_.reserve(max_count_);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "document.h"
+
+// keeps the max_count most relevant documents seen so far in a bounded heap,
+// the least relevant of the kept documents sits on the top of the heap
+class TopDocumentsCollector {
+public:
+    explicit TopDocumentsCollector(size_t max_count);
+
+    void Add(const Document& document);
+    // collectors filled by different threads are merged into one
+    void Merge(const TopDocumentsCollector& other);
+
+    bool IsFull() const;
+    // the document a new one has to beat, valid only for a full collector
+    const Document& GetWorst() const;
+
+    // returns kept documents from the most relevant one, the collector is left empty
+    std::vector<Document> ExtractSorted();
+    // the same, but the heap keeps its memory for the next query
+    std::vector<Document> ExtractSortedCopy();
+    // the same written to out, which has room for all kept documents. Returns their number
+    size_t ExtractSortedTo(Document* out);
+    // empties the collector for a new query without freeing the heap
+    void Reset(size_t max_count);
+
+private:
+    size_t max_count_;
+    std::vector<Document> heap_;
+};
\ No newline at end of file
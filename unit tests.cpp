@@ -1,4 +1,5 @@
 #include "unit tests.h"
+using namespace std::literals;
 // TO DO: improve unit test  *************************************************
 // there are many standard cases which are not tested
 
@@ -15,6 +16,15 @@ void AssertImpl(bool value, const std::string& expr_str, const std::string& file
     }
 }
 
+void AssertSameDocuments(const std::vector<Document>& found, const std::vector<Document>& expected) {
+    ASSERT_EQUAL(found.size(), expected.size());
+    for (size_t i = 0; i < found.size(); ++i) {
+        ASSERT_EQUAL(found[i].id, expected[i].id);
+        ASSERT_EQUAL(found[i].relevance, expected[i].relevance);
+        ASSERT_EQUAL(found[i].rating, expected[i].rating);
+    }
+}
+
 void TestExcludeStopWordsFromAddedDocumentContent() {
     const int doc_id = 42;
     const std::string content = "cat in the city";
@@ -255,4 +265,823 @@ void TestRelevanceCalculation() {
         ASSERT(std::abs(found_docs.at(1).relevance - idf * tf2) < EPSILON);
         ASSERT(std::abs(found_docs.at(2).relevance - idf * tf1) < EPSILON);
     }
+}
+
+void TestTopDocumentsCount() {
+    SearchServer server("");
+    for (int id = 0; id < 10; ++id) {
+        server.AddDocument(id, "cat in the city", DocumentStatus::ACTUAL, { id });
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("cat").size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    ASSERT_EQUAL(server.FindTopDocuments("cat", DocumentStatus::ACTUAL, 3).size(), 3u);
+    ASSERT_HINT(server.FindTopDocuments("cat", DocumentStatus::ACTUAL, 0).empty(),
+        "Zero documents must be returned if zero are requested.");
+
+    const auto all_docs = server.FindTopDocuments(std::execution::par, "cat",
+        [](int, DocumentStatus, int) { return true; }, 100);
+    ASSERT_EQUAL(all_docs.size(), 10u);
+    for (size_t i = 1; i < all_docs.size(); ++i) {
+        ASSERT_HINT(!IsMoreRelevant(all_docs[i], all_docs[i - 1]), "Documents must be sorted in descending order.");
+    }
+    ASSERT_EQUAL(all_docs.front().id, 9);
+}
+
+void TestMaxScoreRetrieval() {
+    SearchServer server("and in the");
+    const std::vector<std::string> texts = {
+        "cat in the city", "white cat and fancy collar", "fluffy cat fluffy tail",
+        "groomed dog expressive eyes", "groomed starling eugene", "dog city cat"
+    };
+    for (int round = 0; round < 50; ++round) {
+        for (size_t i = 0; i < texts.size(); ++i) {
+            server.AddDocument(round * 10 + static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, { round % 7, static_cast<int>(i) });
+        }
+    }
+    for (const std::string query : { "cat", "fluffy groomed cat", "dog city -white", "eugene collar tail", "cat city dog" }) {
+        for (const size_t count : { 1, 5, 40 }) {
+            server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+            const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, count);
+            server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+            const auto found = server.FindTopDocuments(query, DocumentStatus::ACTUAL, count);
+            ASSERT_EQUAL(found.size(), expected.size());
+            for (size_t i = 0; i < found.size(); ++i) {
+                ASSERT_EQUAL_HINT(found[i].id, expected[i].id, "Pruning must not change the result.");
+                ASSERT_HINT(found[i].relevance == expected[i].relevance, "Pruning must not change relevance.");
+            }
+        }
+    }
+}
+
+void TestPostingListCompression() {
+    PostingList postings;
+    std::map<DocumentOrdinal, uint32_t> expected;
+    DocumentOrdinal ordinal = 0;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        ordinal += i % 100 == 0 ? 70000 : i % 7 + 1;
+        const uint32_t count = i % 13 == 0 ? 300 : i % 3 + 1;
+        postings.Insert(ordinal, count, count / 10.0);
+        expected[ordinal] = count;
+    }
+    ASSERT_EQUAL(postings.size(), expected.size());
+    std::map<DocumentOrdinal, uint32_t> listed;
+    postings.ForEach([&listed](DocumentOrdinal posting_ordinal, uint32_t count) { listed[posting_ordinal] = count; });
+    ASSERT_HINT(listed == expected, "Postings must be decoded as they were added.");
+    for (const auto& [posting_ordinal, _] : expected) {
+        ASSERT(postings.Contains(posting_ordinal));
+        ASSERT(!postings.Contains(posting_ordinal + 1) || expected.count(posting_ordinal + 1));
+    }
+
+    PostingCursor cursor(postings);
+    for (auto iter = expected.begin(); iter != expected.end(); std::advance(iter, std::min<size_t>(37, std::distance(iter, expected.end())))) {
+        cursor.NextGeq(iter->first);
+        ASSERT(!cursor.IsEnd());
+        ASSERT_EQUAL(cursor.GetOrdinal(), iter->first);
+        ASSERT_EQUAL(cursor.GetCount(), iter->second);
+    }
+    cursor.NextGeq(expected.rbegin()->first + 1);
+    ASSERT(cursor.IsEnd());
+}
+
+void TestAddAfterRemove() {
+    SearchServer server("and in the");
+    server.AddDocument(1, "cat in the city", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "fluffy cat fluffy tail", DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "groomed dog", DocumentStatus::BANNED, { 3 });
+    server.RemoveDocument(2);
+    server.RemoveDocument(3);
+    // new documents take the places of removed ones and must not inherit their data
+    server.AddDocument(4, "groomed cat", DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "fluffy dog", DocumentStatus::IRRELEVANT, { 5 });
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+
+    const auto found = server.FindTopDocuments("fluffy groomed cat");
+    ASSERT_EQUAL(found.size(), 2u);
+    ASSERT_EQUAL(found[0].id, 4);
+    ASSERT_EQUAL(found[0].rating, 4);
+    ASSERT_EQUAL(found[1].id, 1);
+    ASSERT(server.FindTopDocuments("tail").empty());
+    const auto irrelevant = server.FindTopDocuments("fluffy dog", DocumentStatus::IRRELEVANT);
+    ASSERT_EQUAL(irrelevant.size(), 1u);
+    ASSERT_EQUAL(irrelevant[0].id, 5);
+    ASSERT(std::get<1>(server.MatchDocument("dog", 5)) == DocumentStatus::IRRELEVANT);
+}
+
+void TestDocumentBitmap() {
+    DocumentBitmap bitmap;
+    std::set<DocumentOrdinal> expected;
+    // the first chunk gets dense, the others stay sparse
+    for (DocumentOrdinal ordinal = 0; ordinal < 200000; ordinal += ordinal < 65536 ? 3 : 101) {
+        bitmap.Add(ordinal);
+        expected.insert(ordinal);
+    }
+    for (DocumentOrdinal ordinal = 0; ordinal < 200000; ordinal += 7) {
+        bitmap.Remove(ordinal);
+        expected.erase(ordinal);
+    }
+    ASSERT_EQUAL(bitmap.size(), expected.size());
+    for (DocumentOrdinal ordinal = 0; ordinal < 210000; ++ordinal) {
+        ASSERT_EQUAL(bitmap.Contains(ordinal), expected.count(ordinal) > 0);
+    }
+    ASSERT(bitmap.Intersects(65530, 65540));
+    ASSERT(!bitmap.Intersects(65539, 65638));
+    ASSERT(!bitmap.Intersects(300000, 400000));
+
+    std::vector<DocumentOrdinal> ordinals;
+    for (DocumentOrdinal ordinal = 65000; ordinal < 66000; ordinal += 5) {
+        ordinals.push_back(ordinal);
+    }
+    std::vector<uint32_t> counts(ordinals.size(), 1);
+    const size_t kept = bitmap.Filter(ordinals.data(), counts.data(), ordinals.size());
+    std::vector<DocumentOrdinal> expected_ordinals;
+    for (DocumentOrdinal ordinal = 65000; ordinal < 66000; ordinal += 5) {
+        if (expected.count(ordinal)) {
+            expected_ordinals.push_back(ordinal);
+        }
+    }
+    ASSERT_EQUAL(std::vector<DocumentOrdinal>(ordinals.begin(), ordinals.begin() + kept), expected_ordinals);
+
+    // removing most of a dense chunk turns it back into a sparse one
+    for (DocumentOrdinal ordinal = 0; ordinal < 60000; ++ordinal) {
+        bitmap.Remove(ordinal);
+    }
+    ASSERT(!bitmap.Intersects(0, 59999));
+    ASSERT(bitmap.Contains(60000) == (expected.count(60000) > 0));
+}
+
+void TestTextArena() {
+    TextArena arena(64);
+    std::vector<std::string> texts;
+    std::vector<std::string_view> views;
+    for (int i = 0; i < 100; ++i) {
+        // short strings share slabs, every tenth one is too long for a slab
+        texts.push_back(std::string(i % 10 == 0 ? 100 : i % 7 + 1, static_cast<char>('a' + i % 26)));
+        views.push_back(arena.Append(texts.back()));
+    }
+    ASSERT(arena.Append("").empty());
+    size_t used_bytes = 0;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        ASSERT_EQUAL_HINT(views[i], texts[i], "Views must stay valid after next appends.");
+        used_bytes += texts[i].size();
+    }
+    ASSERT_EQUAL(arena.GetUsedBytes(), used_bytes);
+    ASSERT(arena.GetAllocatedBytes() >= used_bytes);
+}
+
+void TestTermDictionary() {
+    TermDictionary dictionary;
+    const TermId stop_id = dictionary.AddStopWord("and");
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back("word" + std::to_string(i));
+        ASSERT_EQUAL(dictionary.Add(words.back()), static_cast<TermId>(i + 1));
+    }
+    ASSERT_EQUAL(dictionary.size(), 1001u);
+    ASSERT_EQUAL_HINT(dictionary.Add("word500"), 501u, "A known word must keep its id.");
+    for (size_t i = 0; i < words.size(); ++i) {
+        const std::optional<TermId> term_id = dictionary.Find(words[i]);
+        ASSERT(term_id.has_value());
+        ASSERT_EQUAL(dictionary.GetTerm(*term_id), words[i]);
+        ASSERT(!dictionary.IsStopWord(*term_id));
+    }
+    ASSERT(!dictionary.Find("word1000").has_value());
+    ASSERT(!dictionary.Find("").has_value());
+    ASSERT_EQUAL(*dictionary.Find("and"), stop_id);
+    ASSERT_HINT(dictionary.IsStopWord(stop_id), "Stop words must be marked.");
+}
+
+void TestSnapshotSaveLoad() {
+    const std::string path = "test_index.snapshot";
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+    server.AddDocument(4, "groomed starling eugene"s, DocumentStatus::ACTUAL, { 9 });
+    server.RemoveDocument(2);
+    server.SaveSnapshot(path);
+
+    {
+        SearchServer loaded(path, SnapshotAccess::LOAD);
+        ASSERT_EQUAL(loaded.GetDocumentCount(), 3);
+        for (const std::string& query : { "fluffy groomed cat"s, "dog -eyes"s, "cat and collar"s }) {
+            const std::vector<Document> expected = server.FindTopDocuments(query);
+            const std::vector<Document> found = loaded.FindTopDocuments(query);
+            AssertSameDocuments(found, expected);
+        }
+        ASSERT_EQUAL(loaded.FindTopDocuments("dog"s, DocumentStatus::BANNED).size(), 1u);
+        const std::map<std::string_view, double> expected_freqs = server.GetWordFrequencies(1);
+        ASSERT(loaded.GetWordFrequencies(1) == expected_freqs);
+        const auto [words, status] = loaded.MatchDocument("white cat"s, 1);
+        ASSERT_EQUAL(words.size(), 2u);
+
+        // a loaded server is changed as usual
+        loaded.AddDocument(2, "fluffy cat"s, DocumentStatus::ACTUAL, { 1 });
+
+        // the tombstone of the removed document still holds its ordinal, so the saved tables must cover it
+        const std::string resaved_path = "test_index_resaved.snapshot";
+        loaded.SaveSnapshot(resaved_path);
+        for (const SnapshotAccess access : { SnapshotAccess::LOAD, SnapshotAccess::MAP_READ_ONLY }) {
+            const SearchServer reloaded(resaved_path, access);
+            ASSERT_EQUAL(reloaded.GetDocumentCount(), 4);
+            for (const std::string& query : { "fluffy groomed cat"s, "starling -eyes"s }) {
+                AssertSameDocuments(reloaded.FindTopDocuments(query), loaded.FindTopDocuments(query));
+            }
+        }
+        std::remove(resaved_path.c_str());
+
+        loaded.RemoveDocument(4);
+        ASSERT_EQUAL(loaded.GetDocumentCount(), 3);
+        ASSERT_EQUAL(loaded.FindTopDocuments("fluffy"s).size(), 1u);
+        ASSERT(loaded.FindTopDocuments("starling"s).empty());
+    }
+
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-3, std::ios::end);
+        file.put('#');
+    }
+    try {
+        SearchServer corrupted(path, SnapshotAccess::LOAD);
+        ASSERT_HINT(false, "A corrupted snapshot must not be loaded.");
+    }
+    catch (const std::runtime_error&) {
+    }
+    std::remove(path.c_str());
+}
+
+void TestMappedReadOnlySnapshot() {
+    const std::string path = "test_mapped_index.snapshot";
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+    server.SaveSnapshot(path);
+
+    {
+        const SearchServer mapped(path, SnapshotAccess::MAP_READ_ONLY);
+        const std::vector<Document> expected = server.FindTopDocuments("fluffy cat"s);
+        const std::vector<Document> found = mapped.FindTopDocuments("fluffy cat"s);
+        AssertSameDocuments(found, expected);
+        const auto [words, status] = mapped.MatchDocument("dog eyes -cat"s, 3);
+        ASSERT_EQUAL(words.size(), 2u);
+        ASSERT(status == DocumentStatus::BANNED);
+    }
+
+    SearchServer mapped(path, SnapshotAccess::MAP_READ_ONLY);
+    try {
+        mapped.AddDocument(4, "new document"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "A mapped server must reject AddDocument.");
+    }
+    catch (const std::logic_error&) {
+    }
+    try {
+        mapped.RemoveDocument(1);
+        ASSERT_HINT(false, "A mapped server must reject RemoveDocument.");
+    }
+    catch (const std::logic_error&) {
+    }
+    ASSERT_EQUAL(mapped.GetDocumentCount(), 3);
+    std::remove(path.c_str());
+
+    // a mapped snapshot is not checksummed, a broken block header must still be caught
+    const std::string broken_path = "test_broken_index.snapshot";
+    SearchServer large_server("and"s);
+    for (int id = 0; id < 200; ++id) {
+        large_server.AddDocument(id, "black cat"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    large_server.SaveSnapshot(broken_path);
+    std::string content;
+    {
+        std::ifstream input(broken_path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+    const PostingList::Block first_block{ 0, 127, 0, 128, 0, 0, 0.0 };
+    const size_t header_position = content.find(std::string(reinterpret_cast<const char*>(&first_block), 14));
+    ASSERT(header_position != std::string::npos);
+    content[header_position + 14] = 40;
+    {
+        std::ofstream output(broken_path, std::ios::binary);
+        output << content;
+    }
+    try {
+        SearchServer broken(broken_path, SnapshotAccess::MAP_READ_ONLY);
+        ASSERT_HINT(false, "A block header with wrong bit widths must be rejected.");
+    }
+    catch (const std::runtime_error&) {
+    }
+    std::remove(broken_path.c_str());
+}
+
+void TestWriteAheadLogRecovery() {
+    const std::string snapshot_path = "test_checkpoint.snapshot";
+    const std::string log_path = "test_changes.log";
+    std::remove(log_path.c_str());
+    std::vector<Document> expected;
+    {
+        SearchServer server("and in"s);
+        server.OpenWriteAheadLog(log_path, { 2, LogSyncPolicy::NONE });
+        server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+        server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        server.AddDocument(6, "big grey dog"s, DocumentStatus::ACTUAL, { 3 });
+        server.AddDocument(7, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, { 4 });
+        // the checkpoint snapshot holds a tombstone and a document added after it
+        server.RemoveDocument(6);
+        server.AddDocument(8, "grey cat"s, DocumentStatus::ACTUAL, { 2 });
+        server.Checkpoint(snapshot_path);
+        // after the checkpoint only these changes are in the log
+        server.AddDocument(3, "groomed cat expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+        server.RemoveDocument(1);
+        server.AddDocument(4, "groomed starling eugene"s, DocumentStatus::BANNED, { 9 });
+        server.CommitWriteAheadLog();
+        expected = server.FindTopDocuments("groomed fluffy cat"s);
+    }
+    {
+        // a record torn by a crash is cut off
+        std::ofstream log(log_path, std::ios::binary | std::ios::app);
+        log << "torn"s;
+    }
+
+    SearchServer recovered(snapshot_path, SnapshotAccess::LOAD);
+    recovered.OpenWriteAheadLog(log_path);
+    ASSERT_EQUAL(recovered.GetDocumentCount(), 5);
+    const std::vector<Document> found = recovered.FindTopDocuments("groomed fluffy cat"s);
+    AssertSameDocuments(found, expected);
+    ASSERT_EQUAL(recovered.FindTopDocuments("starling"s, DocumentStatus::BANNED).size(), 1u);
+    ASSERT_EQUAL(recovered.FindTopDocuments("grey dog"s).size(), 2u);
+    recovered.AddDocument(5, "new cat"s, DocumentStatus::ACTUAL, { 1 });
+    std::remove(snapshot_path.c_str());
+    std::remove(log_path.c_str());
+}
+
+void TestAddDocumentsBatch() {
+    const std::vector<std::string> texts = {
+        "white cat and fashionable collar"s,
+        "fluffy cat fluffy tail"s,
+        "groomed dog expressive eyes"s,
+        "groomed starling eugene"s,
+    };
+    SearchServer one_by_one("and in"s);
+    SearchServer batched("and in"s);
+    std::vector<NewDocument> batch;
+    for (int i = 0; i < static_cast<int>(texts.size()); ++i) {
+        one_by_one.AddDocument(i, texts[i], DocumentStatus::ACTUAL, { i, 2 * i });
+        batch.push_back({ i, texts[i], DocumentStatus::ACTUAL, { i, 2 * i } });
+    }
+    batched.AddDocuments(batch);
+    ASSERT_EQUAL(batched.GetDocumentCount(), 4);
+    for (const std::string& query : { "fluffy groomed cat"s, "dog -eyes"s, "and collar"s }) {
+        const std::vector<Document> expected = one_by_one.FindTopDocuments(query);
+        const std::vector<Document> found = batched.FindTopDocuments(query);
+        AssertSameDocuments(found, expected);
+    }
+    const std::map<std::string_view, double> expected_freqs = one_by_one.GetWordFrequencies(1);
+    ASSERT(batched.GetWordFrequencies(1) == expected_freqs);
+
+    // a rejected document keeps the whole batch out
+    const std::vector<std::vector<NewDocument>> bad_batches = {
+        { { 10, "new cat", DocumentStatus::ACTUAL, {} }, { 11, "bad\x12word", DocumentStatus::ACTUAL, {} } },
+        { { 10, "new cat", DocumentStatus::ACTUAL, {} }, { 10, "same id", DocumentStatus::ACTUAL, {} } },
+        { { 10, "new cat", DocumentStatus::ACTUAL, {} }, { 1, "existing id", DocumentStatus::ACTUAL, {} } },
+        { { 10, "new cat", DocumentStatus::ACTUAL, {} }, { -1, "negative id", DocumentStatus::ACTUAL, {} } },
+    };
+    for (const std::vector<NewDocument>& bad_batch : bad_batches) {
+        try {
+            batched.AddDocuments(bad_batch);
+            ASSERT_HINT(false, "An invalid batch must be rejected.");
+        }
+        catch (const std::invalid_argument&) {
+        }
+        ASSERT_EQUAL(batched.GetDocumentCount(), 4);
+        ASSERT(batched.FindTopDocuments("new"s).empty());
+    }
+
+    // a batch the log cannot take is kept out of both the index and the log
+    const std::string log_path = "test_batch_changes.log";
+    std::remove(log_path.c_str());
+    {
+        SearchServer logged("and in"s);
+        WriteAheadLogOptions options;
+        options.max_record_size = 64;
+        logged.OpenWriteAheadLog(log_path, options);
+        logged.AddDocuments({ { 1, "fluffy cat", DocumentStatus::ACTUAL, { 1 } } });
+        const std::string long_text(100, 'x');
+        try {
+            logged.AddDocuments({ { 2, "new cat", DocumentStatus::ACTUAL, { 2 } }, { 3, long_text, DocumentStatus::ACTUAL, { 3 } } });
+            ASSERT_HINT(false, "A batch the log rejects must not be added.");
+        }
+        catch (const std::invalid_argument&) {
+        }
+        ASSERT_EQUAL(logged.GetDocumentCount(), 1);
+        ASSERT(logged.FindTopDocuments("new"s).empty());
+        logged.AddDocuments({ { 2, "new cat", DocumentStatus::ACTUAL, { 2 } } });
+        ASSERT_EQUAL(logged.FindTopDocuments("cat"s).size(), 2u);
+    }
+    {
+        SearchServer recovered("and in"s);
+        recovered.OpenWriteAheadLog(log_path);
+        ASSERT_EQUAL(recovered.GetDocumentCount(), 2);
+        ASSERT_EQUAL(recovered.FindTopDocuments("cat"s).size(), 2u);
+    }
+    std::remove(log_path.c_str());
+}
+
+void TestCompactRemovedDocuments() {
+    const std::vector<std::string> texts = {
+        "white cat and fashionable collar"s,
+        "fluffy cat fluffy tail"s,
+        "groomed dog expressive eyes"s,
+        "groomed starling eugene"s,
+        "curly dog and fancy collar"s,
+        "big grey cat"s,
+    };
+    SearchServer server("and"s);
+    SearchServer expected_server("and"s);
+    for (int i = 0; i < static_cast<int>(texts.size()); ++i) {
+        server.AddDocument(i, texts[i], i % 2 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, { i });
+        if (i % 3 != 0) {
+            expected_server.AddDocument(i, texts[i], i % 2 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, { i });
+        }
+    }
+    // the first removal leaves a tombstone, the second one makes removed documents a third and merges them
+    server.RemoveDocument(0);
+    ASSERT(server.FindTopDocuments("white"s, DocumentStatus::BANNED).empty());
+    server.RemoveDocument(3);
+    server.AddDocument(6, "white cat"s, DocumentStatus::ACTUAL, { 6 });
+    expected_server.AddDocument(6, "white cat"s, DocumentStatus::ACTUAL, { 6 });
+
+    for (const std::string& query : { "fluffy groomed cat"s, "dog collar -eyes"s, "white starling"s }) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const std::vector<Document> expected = expected_server.FindTopDocuments(query, status);
+            const std::vector<Document> found = server.FindTopDocuments(query, status);
+            AssertSameDocuments(found, expected);
+        }
+    }
+    const std::map<std::string_view, double> expected_freqs = expected_server.GetWordFrequencies(4);
+    ASSERT(server.GetWordFrequencies(4) == expected_freqs);
+    ASSERT(std::get<1>(server.MatchDocument("dog"s, 4)) == DocumentStatus::BANNED);
+}
+
+void TestConcurrentReadsDuringWrites() {
+    ConcurrentSearchServer server("and"s);
+    server.AddDocument(0, "common cat"s, DocumentStatus::ACTUAL, { 1 });
+    std::atomic<bool> is_writing{ true };
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&server, &is_writing] {
+            int last_count = 0;
+            while (is_writing.load()) {
+                // a version is never seen half-changed: every document has the common word
+                const auto [count, found] = server.Read([](const SearchServer& version) {
+                    return std::make_pair(version.GetDocumentCount(), version.FindTopDocuments("common"s, DocumentStatus::ACTUAL, 1000).size());
+                });
+                ASSERT_EQUAL(static_cast<size_t>(count), found);
+                ASSERT_HINT(count >= last_count, "Readers must not see older versions after newer ones.");
+                last_count = count;
+            }
+        });
+    }
+    for (int id = 1; id <= 200; ++id) {
+        server.AddDocument(id, "common dog number "s + std::to_string(id), DocumentStatus::ACTUAL, { id });
+    }
+    server.AddDocuments({ { 201, "common bird", DocumentStatus::ACTUAL, { 1 } } });
+    is_writing.store(false);
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    ASSERT_EQUAL(server.GetDocumentCount(), 202);
+    server.RemoveDocument(5);
+    ASSERT_EQUAL(server.FindTopDocuments("common"s, DocumentStatus::ACTUAL, 1000).size(), 201u);
+    ASSERT(server.FindTopDocuments("number"s, [](int id, DocumentStatus, int) { return id == 5; }).empty());
+    ASSERT_EQUAL(ProcessQueries(server, { "cat"s, "bird"s })[1].size(), 1u);
+    ASSERT_EQUAL(std::get<0>(server.MatchDocument("bird"s, 201)).size(), 1u);
+}
+
+void TestRemoveDocumentsBatch() {
+    SearchServer server("and"s);
+    SearchServer expected_server("and"s);
+    for (int id = 0; id < 8; ++id) {
+        const std::string text = (id % 2 ? "fluffy cat "s : "groomed dog "s) + "number" + std::to_string(id);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+        if (id != 1 && id != 3 && id != 4) {
+            expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+        }
+    }
+    // unknown ids are skipped
+    server.RemoveDocuments({ 1, 3, 100, 4 });
+    ASSERT_EQUAL(server.GetDocumentCount(), 5);
+    ASSERT(server.FindTopDocuments("number3"s).empty());
+    for (const std::string& query : { "fluffy cat"s, "groomed number6"s }) {
+        const std::vector<Document> expected = expected_server.FindTopDocuments(query);
+        const std::vector<Document> found = server.FindTopDocuments(query);
+        AssertSameDocuments(found, expected);
+    }
+}
+
+void TestSplitIntoWordsView() {
+    // word and separator lengths cross the 16-byte chunks of the vectorized scan
+    std::string text;
+    std::vector<std::string_view> expected_words;
+    std::vector<std::pair<size_t, size_t>> word_bounds;
+    for (size_t i = 0; i < 40; ++i) {
+        const size_t begin = text.size();
+        text += std::string(i % 19, static_cast<char>(i % 3 ? 'a' + i % 26 : '\xE9'));
+        word_bounds.emplace_back(begin, text.size() - begin);
+        text += ' ';
+    }
+    word_bounds.emplace_back(text.size(), 0);
+    for (const auto& [begin, size] : word_bounds) {
+        expected_words.push_back(std::string_view(text).substr(begin, size));
+    }
+
+    std::vector<std::string_view> words = { "stale"sv };
+    ASSERT(SplitIntoWordsView(text, words));
+    ASSERT(words == expected_words);
+    ASSERT(SplitIntoWordsView(std::string_view(text)) == expected_words);
+    ASSERT(SplitIntoWordsView(""sv, words));
+    ASSERT_EQUAL(words.size(), 1u);
+
+    for (const size_t pos : { size_t(0), size_t(15), size_t(16), size_t(100), text.size() - 1 }) {
+        std::string broken = text;
+        broken[pos] = '\x1F';
+        ASSERT_HINT(!SplitIntoWordsView(broken, words), "A control character must be found at any position.");
+        ASSERT(!HasNoControlCharacters(broken));
+    }
+    ASSERT(HasNoControlCharacters(text));
+}
+
+void TestQueryCache() {
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat with a collar"sv, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "groomed dog expressive eyes"sv, DocumentStatus::BANNED, { 3 });
+    server.EnableQueryCache(2, 1);
+
+    const auto first = server.FindTopDocuments("fluffy cat"sv);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 1u);
+    // word order, repeated words and unknown words do not change the parsed query
+    const auto second = server.FindTopDocuments("cat fluffy cat parrot"sv);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 1u);
+    AssertSameDocuments(second, first);
+
+    server.FindTopDocuments("fluffy cat"sv, DocumentStatus::BANNED);
+    server.FindTopDocuments("fluffy cat"sv, DocumentStatus::ACTUAL, 1);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 3u);
+    server.FindTopDocuments("fluffy cat -tail"sv, [](int, DocumentStatus, int) { return true; });
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 3u);
+
+    // the cache holds two queries, the first one is evicted as the least recently used
+    server.FindTopDocuments("fluffy cat"sv);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 4u);
+
+    server.AddDocument(4, "fluffy cat"sv, DocumentStatus::ACTUAL, { 4 });
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy cat"sv).size(), 3u);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 5u);
+    server.RemoveDocument(4);
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy cat"sv).size(), 2u);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 1u);
+
+    // a zero capacity caches nothing
+    server.EnableQueryCache(0, 1);
+    server.FindTopDocuments("fluffy cat"sv);
+    server.FindTopDocuments("fluffy cat"sv);
+    ASSERT_EQUAL(server.GetQueryCacheStats().hits, 0u);
+    ASSERT_EQUAL(server.GetQueryCacheStats().misses, 2u);
+    try {
+        server.EnableQueryCache(2, 0);
+        ASSERT_HINT(false, "A cache without shards must be rejected.");
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestProcessQueriesBatch() {
+    SearchServer server("and with"s);
+    for (int id = 0; id < 40; ++id) {
+        server.AddDocument(id, id % 3 ? "funny pet with curly hair"sv : "nasty rat and big nose"sv, DocumentStatus::ACTUAL, { id });
+    }
+    const std::vector<std::string> queries = { "curly pet"s, "nasty rat -not"s, "pet curly curly"s, ""s, "big nose -rat"s, "curly pet"s };
+    const auto results = ProcessQueries(server, queries);
+    ASSERT_EQUAL(results.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        AssertSameDocuments(results[i], expected);
+    }
+
+    const JoinedDocuments joined = ProcessQueriesJoined(server, queries);
+    ASSERT_EQUAL(joined.offsets.size(), queries.size() + 1);
+    ASSERT_EQUAL(joined.size(), 20u);
+    ASSERT_EQUAL(joined.offsets[3], joined.offsets[4]);
+    size_t count = 0;
+    for (const Document& document : joined) {
+        ASSERT(document.id >= 0);
+        ++count;
+    }
+    ASSERT_EQUAL(count, joined.size());
+
+    // the same documents as the separate results, computed anew and then taken from the cache
+    const auto check_joined = [&queries, &results](const JoinedDocuments& joined_documents) {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const std::vector<Document> found(joined_documents.documents.begin() + joined_documents.offsets[i],
+                joined_documents.documents.begin() + joined_documents.offsets[i + 1]);
+            AssertSameDocuments(found, results[i]);
+        }
+    };
+    check_joined(joined);
+    server.EnableQueryCache(16, 1);
+    check_joined(ProcessQueriesJoined(server, queries));
+    check_joined(ProcessQueriesJoined(server, queries));
+    ASSERT(server.GetQueryCacheStats().hits > 0);
+}
+
+void TestParallelSearchByRanges() {
+    // enough documents for several ordinal ranges, with removed ones among them
+    SearchServer server("and"s);
+    const std::vector<std::string> words = { "cat"s, "dog"s, "bird"s, "fish"s, "rat"s, "tail"s, "ear"s };
+    for (int id = 0; id < 40000; ++id) {
+        std::string text = words[id % 7] + " " + words[id % 5] + " " + words[id % 3] + " " + words[id % 7];
+        server.AddDocument(id, text, static_cast<DocumentStatus>(id % 4 == 0 ? 1 : 0), { id % 13 });
+    }
+    for (int id = 0; id < 40000; id += 9) {
+        server.RemoveDocument(id);
+    }
+
+    const auto check = [&server](const std::string& query, auto predicate, size_t max_count) {
+        const auto sequential = server.FindTopDocuments(std::execution::seq, query, predicate, max_count);
+        const auto parallel = server.FindTopDocuments(std::execution::par, query, predicate, max_count);
+        AssertSameDocuments(parallel, sequential);
+    };
+    for (const std::string& query : { "cat tail"s, "dog -bird"s, "rat fish ear -cat"s, "-dog"s }) {
+        check(query, DocumentStatus::ACTUAL, 5);
+        check(query, DocumentStatus::IRRELEVANT, 1000);
+        check(query, [](int, DocumentStatus, int rating) { return rating > 6; }, 50);
+    }
+}
+
+void TestQueryContextReuse() {
+    SearchServer small_server("and"s);
+    small_server.AddDocument(1, "curly cat curly tail"sv, DocumentStatus::ACTUAL, { 7 });
+    small_server.AddDocument(2, "curly dog and fancy collar"sv, DocumentStatus::ACTUAL, { 1 });
+    SearchServer big_server("and"s);
+    for (int id = 0; id < 3000; ++id) {
+        big_server.AddDocument(id, id % 2 ? "curly cat"sv : "fancy dog curly"sv, DocumentStatus::ACTUAL, { id % 10 });
+    }
+
+    // one context serves servers of different sizes and both ways of retrieval
+    SearchServer::QueryContext context;
+    for (const RetrievalMode mode : { RetrievalMode::EXHAUSTIVE, RetrievalMode::MAX_SCORE }) {
+        small_server.SetRetrievalMode(mode);
+        big_server.SetRetrievalMode(mode);
+        for (const std::string& query : { "curly -dog"s, "fancy cat"s, "curly"s, "-cat"s }) {
+            for (const SearchServer* server : { &big_server, &small_server }) {
+                const auto expected = server->FindTopDocuments(query);
+                const auto found = server->FindTopDocuments(context, query);
+                AssertSameDocuments(found, expected);
+            }
+        }
+    }
+
+    // a predicate may search again, but not with the context its own query holds
+    const auto nested = big_server.FindTopDocuments("curly"sv, [&small_server](int, DocumentStatus, int) {
+        return small_server.FindTopDocuments("cat"sv).size() == 1;
+    });
+    ASSERT_EQUAL(nested.size(), 5u);
+    try {
+        big_server.FindTopDocuments(context, "curly"sv, [&](int, DocumentStatus, int) {
+            return !small_server.FindTopDocuments(context, "cat"sv).empty();
+        });
+        ASSERT_HINT(false, "A context must not serve two queries at once.");
+    }
+    catch (const std::logic_error&) {
+    }
+    ASSERT_EQUAL(small_server.FindTopDocuments(context, "cat"sv).size(), 1u);
+
+    // a predicate throwing in the middle of scoring must not leave scores for the next query
+    big_server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+    try {
+        big_server.FindTopDocuments(context, "curly fancy"sv, [](int document_id, DocumentStatus, int) {
+            if (document_id > 1000) {
+                throw std::out_of_range("stop");
+            }
+            return true;
+        });
+        ASSERT_HINT(false, "The exception of the predicate must reach the caller.");
+    }
+    catch (const std::out_of_range&) {
+    }
+    const auto expected = big_server.FindTopDocuments("curly fancy"sv);
+    const auto found = big_server.FindTopDocuments(context, "curly fancy"sv);
+    AssertSameDocuments(found, expected);
+}
+
+void TestDocumentFilters() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 600; ++id) {
+        server.AddDocument(id, id % 2 ? "white cat and collar"sv : "white dog fancy collar"sv,
+            static_cast<DocumentStatus>(id % 3), { id % 17 - 5 });
+    }
+    for (int id = 0; id < 600; id += 7) {
+        server.RemoveDocument(id);
+    }
+
+    // a known filter must find the same documents as the lambda doing the same check
+    const auto check = [&server](auto filter, auto predicate) {
+        for (const RetrievalMode mode : { RetrievalMode::EXHAUSTIVE, RetrievalMode::MAX_SCORE }) {
+            server.SetRetrievalMode(mode);
+            for (const std::string& query : { "white collar"s, "cat -fancy"s, "dog"s }) {
+                const auto expected = server.FindTopDocuments(query, predicate, 1000);
+                for (const auto& found : { server.FindTopDocuments(query, filter, 1000),
+                    server.FindTopDocuments(std::execution::par, query, filter, 1000) })
+                {
+                    AssertSameDocuments(found, expected);
+                }
+            }
+        }
+    };
+    check(StatusIs{ DocumentStatus::IRRELEVANT },
+        [](int, DocumentStatus status, int) { return status == DocumentStatus::IRRELEVANT; });
+    check(RatingAtLeast{ 4 }, [](int, DocumentStatus, int rating) { return rating >= 4; });
+    check(IdIn({ 14, 3, 5, 8, 3, 599, 1000 }), [](int document_id, DocumentStatus, int) {
+        return document_id == 3 || document_id == 5 || document_id == 8 || document_id == 14 || document_id == 599;
+    });
+    check(AnyDocument{}, [](int, DocumentStatus, int) { return true; });
+    check(AllOf(StatusIs{ DocumentStatus::ACTUAL }, RatingAtLeast{ 0 }, IdIn({ 1, 2, 3, 4, 5, 6, 7, 8, 9, 300 })),
+        [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL && rating >= 0 && (document_id < 10 || document_id == 300);
+        });
+    check(AllOf(StatusIs{ DocumentStatus::ACTUAL }, StatusIs{ DocumentStatus::BANNED }),
+        [](int, DocumentStatus, int) { return false; });
+
+    ASSERT(AllOf(RatingAtLeast{ 2 }, IdIn({ 5 }))(5, DocumentStatus::ACTUAL, 3));
+    ASSERT(!AllOf(RatingAtLeast{ 2 }, IdIn({ 5 }))(5, DocumentStatus::ACTUAL, 1));
+}
+
+void TestRatingIndex() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 500; ++id) {
+        server.AddDocument(id, id % 3 ? "grey cat long tail"sv : "grey dog and long collar"sv,
+            id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 23, id % 7 });
+    }
+
+    // rating order is the order of all found documents by rating, then by relevance
+    const auto check = [&server](const std::string& query, size_t max_count) {
+        std::vector<Document> expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 100000);
+        std::stable_sort(expected.begin(), expected.end(),
+            [](const Document& lhs, const Document& rhs) { return lhs.rating > rhs.rating; });
+        expected.resize(std::min(expected.size(), max_count));
+        const auto found = server.FindTopDocumentsByRating(query, DocumentStatus::ACTUAL, max_count);
+        AssertSameDocuments(found, expected);
+    };
+    check("long tail"s, 5);
+    check("grey -dog"s, 40);
+    check("collar"s, 1000);
+    // more than the eight highest ratings hold, the rest is found in one pass
+    check("grey long"s, 300);
+
+    for (int id = 0; id < 500; id += 3) {
+        server.RemoveDocument(id);
+    }
+    server.AddDocument(1000, "long collar"sv, DocumentStatus::ACTUAL, { 100 });
+    check("long tail"s, 5);
+    check("collar"s, 3);
+    ASSERT_EQUAL(server.FindTopDocumentsByRating("collar"sv)[0].id, 1000);
+    ASSERT_EQUAL(server.FindTopDocuments("long"sv, RatingAtLeast{ 100 }).size(), 1u);
+    server.Compact();
+    check("grey long"s, 10);
+    ASSERT_EQUAL(server.FindTopDocuments("long"sv, RatingAtLeast{ 100 }).size(), 1u);
+    ASSERT(server.FindTopDocuments("long"sv, RatingAtLeast{ 101 }).empty());
+}
+
+void TestRemoveDuplicates() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, { 1, 2 });
+    // the same words in another order and number, stop words do not count
+    server.AddDocument(3, "rat nasty pet funny funny and"sv, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(4, "curly hair funny pet"sv, DocumentStatus::BANNED, { 1, 2 });
+    server.AddDocument(5, "funny pet and not very nasty rat"sv, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(6, "and with"sv, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(7, "with"sv, DocumentStatus::ACTUAL, { 1 });
+
+    const std::vector<int> expected_exact = { 3, 4, 7 };
+    ASSERT(FindDuplicates(server) == expected_exact);
+    ASSERT_EQUAL(server.GetDocumentCount(), 7);
+
+    // document 5 has 6 words, 4 of them are words of document 1
+    DuplicateSearchOptions options;
+    options.similarity_threshold = 0.6;
+    options.hash_count = 64;
+    options.band_count = 64;
+    const std::vector<int> expected_near = { 3, 4, 5, 7 };
+    ASSERT(RemoveDuplicates(server, options) == expected_near);
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+    ASSERT(RemoveDuplicates(server).empty());
+
+    SearchServer large_server("and"s);
+    for (int id = 0; id < 2000; ++id) {
+        large_server.AddDocument(id, "word"s + std::to_string(id % 500) + " common text"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    const std::vector<int> removed = RemoveDuplicates(large_server);
+    ASSERT_EQUAL(removed.size(), 1500u);
+    ASSERT_EQUAL(removed.front(), 500);
+    ASSERT_EQUAL(large_server.GetDocumentCount(), 500);
 }
\ No newline at end of file
@@ -1,10 +1,16 @@
 #pragma once
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <map>
 #include <set>
+#include <thread>
 
+#include "concurrent_search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
 #include "search_server.h"
 
 template <typename T>
@@ -82,6 +88,9 @@ void AssertImpl(bool value, const std::string& expr_str, const std::string& file
 #define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, "")
 #define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
 
+// the same documents in the same order, with exactly the same relevance
+void AssertSameDocuments(const std::vector<Document>& found, const std::vector<Document>& expected);
+
 template <typename F>
 void RunTestImpl(F func, const std::string& func_name) {
     func();
@@ -100,6 +109,28 @@ void TestDocumentRating();
 void TestPredicateFilter();
 void TestSearchDocumentsWithStatus();
 void TestRelevanceCalculation();
+void TestTopDocumentsCount();
+void TestMaxScoreRetrieval();
+void TestPostingListCompression();
+void TestAddAfterRemove();
+void TestDocumentBitmap();
+void TestTextArena();
+void TestTermDictionary();
+void TestSnapshotSaveLoad();
+void TestMappedReadOnlySnapshot();
+void TestWriteAheadLogRecovery();
+void TestAddDocumentsBatch();
+void TestCompactRemovedDocuments();
+void TestConcurrentReadsDuringWrites();
+void TestRemoveDocumentsBatch();
+void TestSplitIntoWordsView();
+void TestQueryCache();
+void TestProcessQueriesBatch();
+void TestParallelSearchByRanges();
+void TestQueryContextReuse();
+void TestDocumentFilters();
+void TestRatingIndex();
+void TestRemoveDuplicates();
 
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
@@ -111,5 +142,27 @@ void TestSearchServer() {
     RUN_TEST(TestPredicateFilter);
     RUN_TEST(TestSearchDocumentsWithStatus);
     RUN_TEST(TestRelevanceCalculation);
-    // amount of tests: 9
+    RUN_TEST(TestTopDocumentsCount);
+    RUN_TEST(TestMaxScoreRetrieval);
+    RUN_TEST(TestPostingListCompression);
+    RUN_TEST(TestAddAfterRemove);
+    RUN_TEST(TestDocumentBitmap);
+    RUN_TEST(TestTextArena);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestSnapshotSaveLoad);
+    RUN_TEST(TestMappedReadOnlySnapshot);
+    RUN_TEST(TestWriteAheadLogRecovery);
+    RUN_TEST(TestAddDocumentsBatch);
+    RUN_TEST(TestCompactRemovedDocuments);
+    RUN_TEST(TestConcurrentReadsDuringWrites);
+    RUN_TEST(TestRemoveDocumentsBatch);
+    RUN_TEST(TestSplitIntoWordsView);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestProcessQueriesBatch);
+    RUN_TEST(TestParallelSearchByRanges);
+    RUN_TEST(TestQueryContextReuse);
+    RUN_TEST(TestDocumentFilters);
+    RUN_TEST(TestRatingIndex);
+    RUN_TEST(TestRemoveDuplicates);
+    // amount of tests: 31
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "snapshot_io.h"
+#include "write_ahead_log.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct RecordHeader {
+    uint32_t payload_size;
+    LogRecordType type;
+    uint64_t sequence;
+    // of the sequence, the type and the payload
+    uint64_t checksum;
+};
+
+// a record larger than this is taken for garbage left by a torn write
+const uint32_t MAX_PAYLOAD_SIZE = uint32_t(1) << 30;
+
+uint64_t ComputeRecordChecksum(const RecordHeader& header, std::string_view payload) {
+    SnapshotChecksum checksum;
+    checksum.Update(reinterpret_cast<const char*>(&header.sequence), sizeof(header.sequence));
+    checksum.Update(reinterpret_cast<const char*>(&header.type), sizeof(header.type));
+    checksum.Update(payload.data(), payload.size());
+    return checksum.Get();
+}
+
+template <typename T>
+void PutValue(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool TakeValue(std::string_view& in, T& value) {
+    if (in.size() < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+std::string MakeAddPayload(int document_id, std::string_view text, DocumentStatus status, const std::vector<int>& ratings) {
+    std::string payload;
+    payload.reserve(sizeof(document_id) + sizeof(status) + sizeof(uint32_t) + ratings.size() * sizeof(int) + text.size());
+    PutValue(payload, document_id);
+    PutValue(payload, status);
+    PutValue(payload, static_cast<uint32_t>(ratings.size()));
+    payload.append(reinterpret_cast<const char*>(ratings.data()), ratings.size() * sizeof(int));
+    payload.append(text);
+    return payload;
+}
+
+bool ParsePayload(std::string_view payload, LogRecord& record) {
+    if (!TakeValue(payload, record.document_id)) {
+        return false;
+    }
+    if (record.type == LogRecordType::REMOVE_DOCUMENT) {
+        return payload.empty();
+    }
+    if (record.type != LogRecordType::ADD_DOCUMENT) {
+        return false;
+    }
+    uint32_t rating_count = 0;
+    if (!TakeValue(payload, record.status) || !TakeValue(payload, rating_count)
+        || payload.size() < size_t(rating_count) * sizeof(int))
+    {
+        return false;
+    }
+    record.ratings.resize(rating_count);
+    for (int& rating : record.ratings) {
+        TakeValue(payload, rating);
+    }
+    record.text.assign(payload.data(), payload.size());
+    return true;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& path, const WriteAheadLogOptions& options,
+    const std::function<void(const LogRecord&)>& replay)
+    : path_(path)
+    , options_(options)
+    , last_sync_(std::chrono::steady_clock::now())
+{
+    uint64_t valid_size = 0;
+    {
+        std::ifstream in(path, std::ios::binary);
+        RecordHeader header;
+        std::string payload;
+        LogRecord record;
+        while (in.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.payload_size <= MAX_PAYLOAD_SIZE) {
+            payload.resize(header.payload_size);
+            if (!in.read(payload.data(), header.payload_size) || ComputeRecordChecksum(header, payload) != header.checksum) {
+                break;
+            }
+            record.type = header.type;
+            record.sequence = header.sequence;
+            if (!ParsePayload(payload, record)) {
+                break;
+            }
+            replay(record);
+            valid_size += sizeof(header) + header.payload_size;
+        }
+    }
+    // everything after the last whole record was being written when the process stopped
+    std::error_code error;
+    if (std::filesystem::exists(path, error) && std::filesystem::file_size(path) > valid_size) {
+        std::filesystem::resize_file(path, valid_size);
+    }
+    committed_size_ = valid_size;
+
+    file_ = std::fopen(path.c_str(), "ab");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot open write-ahead log " + path);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        Commit();
+    }
+    catch (const std::exception&) {
+    }
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+}
+
+void WriteAheadLog::AppendAdd(uint64_t sequence, int document_id, std::string_view text, DocumentStatus status,
+    const std::vector<int>& ratings)
+{
+    AppendRecord(LogRecordType::ADD_DOCUMENT, sequence, MakeAddPayload(document_id, text, status, ratings));
+}
+
+void WriteAheadLog::AppendAdds(uint64_t first_sequence, const std::vector<NewDocument>& documents) {
+    const size_t pending_size = pending_.size();
+    const size_t pending_records = pending_records_;
+    try {
+        for (size_t i = 0; i < documents.size(); ++i) {
+            const NewDocument& document = documents[i];
+            BufferRecord(LogRecordType::ADD_DOCUMENT, first_sequence + i,
+                MakeAddPayload(document.id, document.text, document.status, document.ratings));
+        }
+        // the batch is one group, it goes with one write
+        if (pending_records_ >= options_.group_commit_size) {
+            Commit();
+        }
+    }
+    catch (...) {
+        // the batch is not applied, its records must not be written by a later commit
+        pending_.resize(pending_size);
+        pending_records_ = pending_records;
+        throw;
+    }
+}
+
+void WriteAheadLog::AppendRemove(uint64_t sequence, int document_id) {
+    std::string payload;
+    PutValue(payload, document_id);
+    AppendRecord(LogRecordType::REMOVE_DOCUMENT, sequence, payload);
+}
+
+void WriteAheadLog::Commit() {
+    if (pending_.empty()) {
+        return;
+    }
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot write to write-ahead log " + path_);
+    }
+    // the whole group goes with one write and at most one sync
+    if (std::fwrite(pending_.data(), 1, pending_.size(), file_) != pending_.size() || std::fflush(file_) != 0) {
+        // a partly written group and the bytes left in the stream buffer are dropped,
+        // the records stay pending and a later commit writes them whole
+        std::fclose(file_);
+        std::error_code error;
+        std::filesystem::resize_file(path_, committed_size_, error);
+        file_ = std::fopen(path_.c_str(), "ab");
+        throw std::runtime_error("Cannot write to write-ahead log " + path_);
+    }
+    committed_size_ += pending_.size();
+    pending_.clear();
+    pending_records_ = 0;
+    if (options_.sync_policy == LogSyncPolicy::EVERY_COMMIT
+        || (options_.sync_policy == LogSyncPolicy::INTERVAL
+            && std::chrono::steady_clock::now() - last_sync_ >= options_.sync_interval))
+    {
+        Sync();
+    }
+}
+
+void WriteAheadLog::Truncate() {
+    pending_.clear();
+    pending_records_ = 0;
+    // not synced: if the truncation is lost, replay skips records older than the snapshot anyway
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+    file_ = std::fopen(path_.c_str(), "wb");
+    committed_size_ = 0;
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot truncate write-ahead log " + path_);
+    }
+}
+
+void WriteAheadLog::AppendRecord(LogRecordType type, uint64_t sequence, std::string_view payload) {
+    const size_t pending_size = pending_.size();
+    const size_t pending_records = pending_records_;
+    BufferRecord(type, sequence, payload);
+    if (pending_records_ >= options_.group_commit_size) {
+        try {
+            Commit();
+        }
+        catch (...) {
+            // the change is not applied and its sequence number is given to the next one
+            pending_.resize(pending_size);
+            pending_records_ = pending_records;
+            throw;
+        }
+    }
+}
+
+void WriteAheadLog::BufferRecord(LogRecordType type, uint64_t sequence, std::string_view payload) {
+    if (payload.size() > std::min(MAX_PAYLOAD_SIZE, options_.max_record_size)) {
+        throw std::invalid_argument("Document is too large for write-ahead log");
+    }
+    RecordHeader header = {};
+    header.payload_size = static_cast<uint32_t>(payload.size());
+    header.type = type;
+    header.sequence = sequence;
+    header.checksum = ComputeRecordChecksum(header, payload);
+    PutValue(pending_, header);
+    pending_.append(payload);
+    ++pending_records_;
+}
+
+void WriteAheadLog::Sync() {
+#ifdef _WIN32
+    const int result = _commit(_fileno(file_));
+#else
+    const int result = fsync(fileno(file_));
+#endif
+    if (result != 0) {
+        throw std::runtime_error("Cannot sync write-ahead log " + path_);
+    }
+    last_sync_ = std::chrono::steady_clock::now();
+}
\ No newline at end of file
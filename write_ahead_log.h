@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+enum class LogSyncPolicy {
+    // every commit is flushed to disk with fsync, a committed change survives power loss
+    EVERY_COMMIT,
+    // fsync at most once per sync_interval, a crash of the machine loses the last interval
+    INTERVAL,
+    // the operating system decides, only a crash of the process is survived
+    NONE,
+};
+
+struct WriteAheadLogOptions {
+    // group commit: records are written together once this many are buffered
+    // or when the log is committed explicitly. 1 writes every change at once
+    size_t group_commit_size = 1;
+    LogSyncPolicy sync_policy = LogSyncPolicy::EVERY_COMMIT;
+    std::chrono::milliseconds sync_interval{ 100 };
+    // a change with a larger record is rejected with invalid_argument
+    uint32_t max_record_size = uint32_t(1) << 30;
+};
+
+enum class LogRecordType : uint32_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+};
+
+struct LogRecord {
+    LogRecordType type = LogRecordType::ADD_DOCUMENT;
+    // sequence numbers grow by one with every change, a snapshot remembers the last one it contains
+    uint64_t sequence = 0;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+// append-only log of index changes. Every record carries its size and checksum,
+// so a record torn by a crash is detected and cut off when the log is opened
+class WriteAheadLog {
+public:
+    // records already in the file are passed to replay in order before anything is appended
+    WriteAheadLog(const std::string& path, const WriteAheadLogOptions& options,
+        const std::function<void(const LogRecord&)>& replay);
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    // pending records are committed
+    ~WriteAheadLog();
+
+    void AppendAdd(uint64_t sequence, int document_id, std::string_view text, DocumentStatus status,
+        const std::vector<int>& ratings);
+    // the documents get sequences from first_sequence on. If some record cannot be appended
+    // or committed, none of the batch reaches the log
+    void AppendAdds(uint64_t first_sequence, const std::vector<NewDocument>& documents);
+    void AppendRemove(uint64_t sequence, int document_id);
+
+    // writes the buffered records and syncs them according to the policy
+    void Commit();
+    // drops all records, called once they are in a snapshot
+    void Truncate();
+
+private:
+    std::string path_;
+    WriteAheadLogOptions options_;
+    std::FILE* file_ = nullptr;
+    // bytes of whole committed records in the file
+    uint64_t committed_size_ = 0;
+    std::string pending_;
+    size_t pending_records_ = 0;
+    std::chrono::steady_clock::time_point last_sync_;
+
+    void AppendRecord(LogRecordType type, uint64_t sequence, std::string_view payload);
+    // only buffers, the record is written by the next Commit
+    void BufferRecord(LogRecordType type, uint64_t sequence, std::string_view payload);
+    void Sync();
+};
\ No newline at end of file